@@ -0,0 +1,392 @@
+#include "bigint.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+
+typedef std::vector<uint32_t> Digits;
+
+const uint64_t kBase = uint64_t(1) << 32;
+// Десятичный разряд при печати и разборе: 10^9 помещается в uint32
+const uint32_t kDecimalBase = 1000000000;
+const size_t kDecimalDigits = 9;
+// Короче этого (в 32-битных разрядах) Карацуба медленнее школьного умножения
+const size_t kKaratsubaThreshold = 32;
+
+void Trim(Digits *digits) {
+  while (!digits->empty() && digits->back() == 0) {
+    digits->pop_back();
+  }
+}
+
+int CompareMagnitude(const Digits &lhs, const Digits &rhs) {
+  if (lhs.size() != rhs.size()) {
+    return lhs.size() < rhs.size() ? -1 : 1;
+  }
+  for (size_t i = lhs.size(); i-- > 0;) {
+    if (lhs[i] != rhs[i]) {
+      return lhs[i] < rhs[i] ? -1 : 1;
+    }
+  }
+  return 0;
+}
+
+Digits AddMagnitude(const Digits &lhs, const Digits &rhs) {
+  const Digits &longer = lhs.size() >= rhs.size() ? lhs : rhs;
+  const Digits &shorter = lhs.size() >= rhs.size() ? rhs : lhs;
+  Digits result(longer.size() + 1);
+  uint64_t carry = 0;
+  for (size_t i = 0; i < longer.size(); ++i) {
+    uint64_t sum = carry + longer[i] + (i < shorter.size() ? shorter[i] : 0);
+    result[i] = static_cast<uint32_t>(sum);
+    carry = sum >> 32;
+  }
+  result.back() = static_cast<uint32_t>(carry);
+  Trim(&result);
+  return result;
+}
+
+// lhs >= rhs по модулю
+Digits SubMagnitude(const Digits &lhs, const Digits &rhs) {
+  Digits result(lhs.size());
+  int64_t borrow = 0;
+  for (size_t i = 0; i < lhs.size(); ++i) {
+    int64_t diff = static_cast<int64_t>(lhs[i]) - borrow -
+                   (i < rhs.size() ? static_cast<int64_t>(rhs[i]) : 0);
+    borrow = diff < 0;
+    result[i] = static_cast<uint32_t>(diff + (borrow ? kBase : 0));
+  }
+  Trim(&result);
+  return result;
+}
+
+// result[offset..] += digits; result достаточно длинный
+void AddShifted(Digits *result, const Digits &digits, size_t offset) {
+  uint64_t carry = 0;
+  size_t i = 0;
+  for (; i < digits.size(); ++i) {
+    uint64_t sum = carry + (*result)[offset + i] + digits[i];
+    (*result)[offset + i] = static_cast<uint32_t>(sum);
+    carry = sum >> 32;
+  }
+  for (; carry; ++i) {
+    uint64_t sum = carry + (*result)[offset + i];
+    (*result)[offset + i] = static_cast<uint32_t>(sum);
+    carry = sum >> 32;
+  }
+}
+
+Digits SchoolbookMultiply(const Digits &lhs, const Digits &rhs) {
+  Digits result(lhs.size() + rhs.size());
+  for (size_t i = 0; i < lhs.size(); ++i) {
+    uint64_t carry = 0;
+    for (size_t j = 0; j < rhs.size(); ++j) {
+      uint64_t product = static_cast<uint64_t>(lhs[i]) * rhs[j] + result[i + j] + carry;
+      result[i + j] = static_cast<uint32_t>(product);
+      carry = product >> 32;
+    }
+    result[i + rhs.size()] = static_cast<uint32_t>(carry);
+  }
+  Trim(&result);
+  return result;
+}
+
+// Младшие (low) и старшие разряды после split
+void Split(const Digits &digits, size_t split, Digits *low, Digits *high) {
+  auto middle = digits.begin() + std::min(split, digits.size());
+  low->assign(digits.begin(), middle);
+  high->assign(middle, digits.end());
+  Trim(low);
+}
+
+// (a1 B + a0)(b1 B + b0) = z2 B^2 + ((a0 + a1)(b0 + b1) - z2 - z0) B + z0
+Digits MultiplyMagnitude(const Digits &lhs, const Digits &rhs) {
+  if (lhs.empty() || rhs.empty()) {
+    return Digits();
+  }
+  size_t split = std::max(lhs.size(), rhs.size()) / 2;
+  if (std::min(lhs.size(), rhs.size()) <= std::max(split, kKaratsubaThreshold)) {
+    return SchoolbookMultiply(lhs, rhs);
+  }
+  Digits lhs_low, lhs_high, rhs_low, rhs_high;
+  Split(lhs, split, &lhs_low, &lhs_high);
+  Split(rhs, split, &rhs_low, &rhs_high);
+  auto low = MultiplyMagnitude(lhs_low, rhs_low);
+  auto high = MultiplyMagnitude(lhs_high, rhs_high);
+  auto middle = MultiplyMagnitude(AddMagnitude(lhs_low, lhs_high),
+                                  AddMagnitude(rhs_low, rhs_high));
+  middle = SubMagnitude(SubMagnitude(middle, low), high);
+  Digits result(lhs.size() + rhs.size() + 1);
+  AddShifted(&result, low, 0);
+  AddShifted(&result, middle, split);
+  AddShifted(&result, high, 2 * split);
+  Trim(&result);
+  return result;
+}
+
+// Деление на один разряд, возвращает остаток
+uint32_t DivideByDigit(Digits *digits, uint32_t divisor) {
+  uint64_t remainder = 0;
+  for (size_t i = digits->size(); i-- > 0;) {
+    uint64_t current = remainder << 32 | (*digits)[i];
+    (*digits)[i] = static_cast<uint32_t>(current / divisor);
+    remainder = current % divisor;
+  }
+  Trim(digits);
+  return static_cast<uint32_t>(remainder);
+}
+
+// digits = digits * factor + addend
+void MultiplyAdd(Digits *digits, uint32_t factor, uint32_t addend) {
+  uint64_t carry = addend;
+  for (auto &digit : *digits) {
+    uint64_t current = static_cast<uint64_t>(digit) * factor + carry;
+    digit = static_cast<uint32_t>(current);
+    carry = current >> 32;
+  }
+  if (carry) {
+    digits->push_back(static_cast<uint32_t>(carry));
+  }
+}
+
+int LeadingZeros(uint32_t digit) {
+  int count = 0;
+  while (!(digit & 0x80000000u)) {
+    digit <<= 1;
+    ++count;
+  }
+  return count;
+}
+
+// Деление столбиком (Кнут, алгоритм D); делитель длиннее одного разряда
+void LongDivide(const Digits &lhs, const Digits &rhs, Digits *quotient,
+                Digits *remainder) {
+  size_t n = rhs.size();
+  size_t m = lhs.size();
+  // Нормализация: старший бит делителя единичный, оценка qhat ошибается не больше чем на 2
+  int shift = LeadingZeros(rhs.back());
+  Digits divisor(n);
+  Digits rest(m + 1);
+  for (size_t i = n; i-- > 0;) {
+    divisor[i] = rhs[i] << shift |
+                 (shift && i > 0 ? rhs[i - 1] >> (32 - shift) : 0);
+  }
+  rest[m] = shift ? lhs[m - 1] >> (32 - shift) : 0;
+  for (size_t i = m; i-- > 0;) {
+    rest[i] = lhs[i] << shift |
+              (shift && i > 0 ? lhs[i - 1] >> (32 - shift) : 0);
+  }
+  quotient->assign(m - n + 1, 0);
+  for (size_t j = m - n + 1; j-- > 0;) {
+    uint64_t numerator = static_cast<uint64_t>(rest[j + n]) << 32 | rest[j + n - 1];
+    uint64_t qhat = numerator / divisor[n - 1];
+    uint64_t rhat = numerator % divisor[n - 1];
+    while (qhat >= kBase ||
+           qhat * divisor[n - 2] > (rhat << 32 | rest[j + n - 2])) {
+      --qhat;
+      rhat += divisor[n - 1];
+      if (rhat >= kBase) {
+        break;
+      }
+    }
+    int64_t borrow = 0;
+    int64_t diff;
+    for (size_t i = 0; i < n; ++i) {
+      uint64_t product = qhat * divisor[i];
+      diff = static_cast<int64_t>(rest[i + j]) - borrow -
+             static_cast<int64_t>(product & 0xFFFFFFFF);
+      rest[i + j] = static_cast<uint32_t>(diff);
+      borrow = static_cast<int64_t>(product >> 32) - (diff >> 32);
+    }
+    diff = static_cast<int64_t>(rest[j + n]) - borrow;
+    rest[j + n] = static_cast<uint32_t>(diff);
+    (*quotient)[j] = static_cast<uint32_t>(qhat);
+    if (diff < 0) {
+      // Оценка оказалась на единицу больше: возвращаем делитель
+      --(*quotient)[j];
+      uint64_t carry = 0;
+      for (size_t i = 0; i < n; ++i) {
+        uint64_t sum = static_cast<uint64_t>(rest[i + j]) + divisor[i] + carry;
+        rest[i + j] = static_cast<uint32_t>(sum);
+        carry = sum >> 32;
+      }
+      rest[j + n] += static_cast<uint32_t>(carry);
+    }
+  }
+  remainder->resize(n);
+  for (size_t i = 0; i < n; ++i) {
+    (*remainder)[i] = rest[i] >> shift |
+                      (shift ? rest[i + 1] << (32 - shift) : 0);
+  }
+  Trim(quotient);
+  Trim(remainder);
+}
+
+} // namespace
+
+BigInt::BigInt(int64_t value) : negative_(value < 0) {
+  // Модуль INT64_MIN не помещается в int64, поэтому считаем в беззнаковом
+  uint64_t magnitude = negative_ ? uint64_t(0) - static_cast<uint64_t>(value)
+                                 : static_cast<uint64_t>(value);
+  while (magnitude) {
+    digits_.push_back(static_cast<uint32_t>(magnitude));
+    magnitude >>= 32;
+  }
+}
+
+BigInt::BigInt(bool negative, Digits digits)
+    : negative_(negative), digits_(std::move(digits)) {
+  Trim(&digits_);
+  if (digits_.empty()) {
+    negative_ = false;
+  }
+}
+
+BigInt BigInt::Parse(std::string_view text) {
+  bool negative = false;
+  if (!text.empty() && (text[0] == '-' || text[0] == '+')) {
+    negative = text[0] == '-';
+    text.remove_prefix(1);
+  }
+  if (text.empty()) {
+    throw std::invalid_argument("Invalid integer");
+  }
+  Digits digits;
+  // Первая группа короче, остальные ровно по kDecimalDigits цифр
+  size_t group = text.size() % kDecimalDigits;
+  if (group == 0) {
+    group = kDecimalDigits;
+  }
+  for (size_t pos = 0; pos < text.size(); pos += group, group = kDecimalDigits) {
+    uint32_t chunk = 0;
+    uint32_t scale = 1;
+    for (size_t i = pos; i < pos + group; ++i) {
+      if (text[i] < '0' || text[i] > '9') {
+        throw std::invalid_argument("Invalid integer");
+      }
+      chunk = chunk * 10 + (text[i] - '0');
+      scale *= 10;
+    }
+    MultiplyAdd(&digits, scale, chunk);
+  }
+  return BigInt(negative, std::move(digits));
+}
+
+bool BigInt::FitsInt64() const {
+  if (digits_.size() > 2) {
+    return false;
+  }
+  uint64_t magnitude = 0;
+  for (size_t i = digits_.size(); i-- > 0;) {
+    magnitude = magnitude << 32 | digits_[i];
+  }
+  return negative_ ? magnitude <= uint64_t(1) << 63 : magnitude < uint64_t(1) << 63;
+}
+
+int64_t BigInt::ToInt64() const {
+  uint64_t magnitude = 0;
+  for (size_t i = digits_.size(); i-- > 0;) {
+    magnitude = magnitude << 32 | digits_[i];
+  }
+  return static_cast<int64_t>(negative_ ? uint64_t(0) - magnitude : magnitude);
+}
+
+double BigInt::ToDouble() const {
+  double result = 0;
+  for (size_t i = digits_.size(); i-- > 0;) {
+    result = result * static_cast<double>(kBase) + digits_[i];
+  }
+  return negative_ ? -result : result;
+}
+
+size_t BigInt::Hash() const {
+  size_t hash = negative_;
+  for (auto digit : digits_) {
+    hash = hash * 0x100000001b3 ^ digit;
+  }
+  return hash;
+}
+
+std::string BigInt::ToString() const {
+  if (digits_.empty()) {
+    return "0";
+  }
+  Digits rest = digits_;
+  std::vector<uint32_t> groups;
+  while (!rest.empty()) {
+    groups.push_back(DivideByDigit(&rest, kDecimalBase));
+  }
+  std::string result = negative_ ? "-" : "";
+  result += std::to_string(groups.back());
+  for (size_t i = groups.size() - 1; i-- > 0;) {
+    auto group = std::to_string(groups[i]);
+    result.append(kDecimalDigits - group.size(), '0');
+    result += group;
+  }
+  return result;
+}
+
+BigInt BigInt::operator-() const { return BigInt(!negative_, digits_); }
+
+BigInt BigInt::Abs() const { return BigInt(false, digits_); }
+
+BigInt operator+(const BigInt &lhs, const BigInt &rhs) {
+  if (lhs.negative_ == rhs.negative_) {
+    return BigInt(lhs.negative_, AddMagnitude(lhs.digits_, rhs.digits_));
+  }
+  // Разные знаки: из большего по модулю вычитается меньший
+  if (CompareMagnitude(lhs.digits_, rhs.digits_) >= 0) {
+    return BigInt(lhs.negative_, SubMagnitude(lhs.digits_, rhs.digits_));
+  }
+  return BigInt(rhs.negative_, SubMagnitude(rhs.digits_, lhs.digits_));
+}
+
+BigInt operator-(const BigInt &lhs, const BigInt &rhs) { return lhs + -rhs; }
+
+BigInt operator*(const BigInt &lhs, const BigInt &rhs) {
+  return BigInt(lhs.negative_ != rhs.negative_,
+                MultiplyMagnitude(lhs.digits_, rhs.digits_));
+}
+
+void BigInt::DivMod(const BigInt &lhs, const BigInt &rhs, BigInt *quotient,
+                    BigInt *remainder) {
+  Digits quotient_digits;
+  Digits remainder_digits;
+  if (CompareMagnitude(lhs.digits_, rhs.digits_) < 0) {
+    remainder_digits = lhs.digits_;
+  } else if (rhs.digits_.size() == 1) {
+    quotient_digits = lhs.digits_;
+    uint32_t rest = DivideByDigit(&quotient_digits, rhs.digits_[0]);
+    if (rest) {
+      remainder_digits.push_back(rest);
+    }
+  } else {
+    LongDivide(lhs.digits_, rhs.digits_, &quotient_digits, &remainder_digits);
+  }
+  // Остаток имеет знак делимого, частное округлено к нулю
+  *quotient = BigInt(lhs.negative_ != rhs.negative_, std::move(quotient_digits));
+  *remainder = BigInt(lhs.negative_, std::move(remainder_digits));
+}
+
+BigInt operator/(const BigInt &lhs, const BigInt &rhs) {
+  BigInt quotient;
+  BigInt remainder;
+  BigInt::DivMod(lhs, rhs, &quotient, &remainder);
+  return quotient;
+}
+
+BigInt operator%(const BigInt &lhs, const BigInt &rhs) {
+  BigInt quotient;
+  BigInt remainder;
+  BigInt::DivMod(lhs, rhs, &quotient, &remainder);
+  return remainder;
+}
+
+int Compare(const BigInt &lhs, const BigInt &rhs) {
+  if (lhs.negative_ != rhs.negative_) {
+    return lhs.negative_ ? -1 : 1;
+  }
+  int magnitude = CompareMagnitude(lhs.digits_, rhs.digits_);
+  return lhs.negative_ ? -magnitude : magnitude;
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+//// Проверка переполнения int64
+// Результат записывается в out только без переполнения
+inline bool AddOverflow(int64_t a, int64_t b, int64_t* out) {
+#if defined(__GNUC__)
+    return __builtin_add_overflow(a, b, out);
+#else
+    if ((b > 0 && a > INT64_MAX - b) || (b < 0 && a < INT64_MIN - b)) {
+        return true;
+    }
+    *out = a + b;
+    return false;
+#endif
+}
+
+inline bool SubOverflow(int64_t a, int64_t b, int64_t* out) {
+#if defined(__GNUC__)
+    return __builtin_sub_overflow(a, b, out);
+#else
+    if ((b < 0 && a > INT64_MAX + b) || (b > 0 && a < INT64_MIN + b)) {
+        return true;
+    }
+    *out = a - b;
+    return false;
+#endif
+}
+
+inline bool MulOverflow(int64_t a, int64_t b, int64_t* out) {
+#if defined(__GNUC__)
+    return __builtin_mul_overflow(a, b, out);
+#else
+    if (a != 0 && b != 0) {
+        int64_t product = static_cast<int64_t>(static_cast<uint64_t>(a) * static_cast<uint64_t>(b));
+        if ((a == -1 && b == INT64_MIN) || (b == -1 && a == INT64_MIN) || product / b != a) {
+            return true;
+        }
+        *out = product;
+        return false;
+    }
+    *out = 0;
+    return false;
+#endif
+}
+////
+
+//// Целое произвольной длины
+// Знак и модуль: 32-битные разряды от младшего к старшему, без ведущих нулей,
+// у нуля разрядов нет. Длинные произведения считаются по Карацубе.
+// Интерпретатор хранит в BigInt только значения вне диапазона fixnum
+class BigInt {
+public:
+    BigInt() = default;
+    explicit BigInt(int64_t value);
+
+    // Десятичная запись с необязательным знаком; std::invalid_argument при ошибке
+    static BigInt Parse(std::string_view text);
+
+    bool IsZero() const {
+        return digits_.empty();
+    }
+    bool IsNegative() const {
+        return negative_;
+    }
+    bool FitsInt64() const;
+    // Для значений, у которых FitsInt64
+    int64_t ToInt64() const;
+    // Ближайшее double (для больших значений - с потерей младших разрядов)
+    double ToDouble() const;
+    std::string ToString() const;
+    // Равные числа дают равный хеш
+    size_t Hash() const;
+
+    BigInt operator-() const;
+    BigInt Abs() const;
+
+    friend BigInt operator+(const BigInt& lhs, const BigInt& rhs);
+    friend BigInt operator-(const BigInt& lhs, const BigInt& rhs);
+    friend BigInt operator*(const BigInt& lhs, const BigInt& rhs);
+    // Деление с отбрасыванием дробной части, как quotient в Scheme.
+    // Делитель не должен быть нулём
+    friend BigInt operator/(const BigInt& lhs, const BigInt& rhs);
+    friend BigInt operator%(const BigInt& lhs, const BigInt& rhs);
+
+    // <0, 0 или >0
+    friend int Compare(const BigInt& lhs, const BigInt& rhs);
+
+    // Память под цифры вне самого объекта
+    size_t DigitBytes() const {
+        return digits_.capacity() * sizeof(uint32_t);
+    }
+
+private:
+    typedef std::vector<uint32_t> Digits;
+
+    BigInt(bool negative, Digits digits);
+    static void DivMod(const BigInt& lhs, const BigInt& rhs, BigInt* quotient,
+                       BigInt* remainder);
+
+    bool negative_ = false;
+    Digits digits_;
+};
+////
@@ -0,0 +1,589 @@
+#include "compiler.h"
+#include "profiler.h"
+#include "runtime_stats.h"
+#include "scheme.h"
+#include <algorithm>
+#include <pthread.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#if defined(__GNUC__)
+#define SCHEME_NOINLINE __attribute__((noinline))
+#else
+#define SCHEME_NOINLINE
+#endif
+
+namespace {
+
+Value ExecuteBody(const LambdaCode &code, const Env &env) {
+  Value last_val = nullptr;
+  for (auto &node : code.body) {
+    last_val = node->Execute(env);
+  }
+  return last_val;
+}
+
+// Вложенные (не хвостовые) вызовы лямбд занимают нативный стек. Его расход
+// на уровень зависит от формы тела, поэтому ограничен не счётчик, а объём:
+// стек потока без запаса на встроенные функции и обработку исключения.
+// Переполнение - ошибка, а не падение
+const size_t kStackMargin = 256 << 10;
+// Если размер стека узнать не удалось
+const size_t kDefaultStackBytes = 8 << 20;
+thread_local size_t call_depth = 0;
+thread_local const char *stack_limit = nullptr;
+
+// Нижняя граница стека текущего потока вместе с запасом. Стек главного
+// потока растёт до RLIMIT_STACK, размер стека остальных задан при создании
+const char *StackLimit(const char *here) {
+  const char *bottom = nullptr;
+  const char *top = here;
+  pthread_attr_t attr;
+  if (pthread_getattr_np(pthread_self(), &attr) == 0) {
+    void *addr = nullptr;
+    size_t size = 0;
+    if (pthread_attr_getstack(&attr, &addr, &size) == 0 && addr) {
+      bottom = static_cast<const char *>(addr);
+      top = bottom + size;
+    }
+    pthread_attr_destroy(&attr);
+  }
+  if (getpid() == static_cast<pid_t>(syscall(SYS_gettid))) {
+    rlimit limit;
+    if (getrlimit(RLIMIT_STACK, &limit) == 0 &&
+        limit.rlim_cur != RLIM_INFINITY) {
+      // Ниже могут лежать другие отображения: тогда граница - они
+      bottom = std::max(bottom, top - limit.rlim_cur);
+    }
+  }
+  if (!bottom) {
+    bottom = top - kDefaultStackBytes;
+  }
+  return bottom + kStackMargin;
+}
+
+class CallDepthGuard {
+public:
+  CallDepthGuard() {
+    const char *here = reinterpret_cast<const char *>(&here);
+    if (!stack_limit) {
+      stack_limit = StackLimit(here);
+    }
+    if (here < stack_limit) {
+      throw RuntimeError("Stack overflow");
+    }
+    ++call_depth;
+    RuntimeCounters::Current().NoteCallDepth(call_depth);
+  }
+  ~CallDepthGuard() { --call_depth; }
+};
+
+// Снимает со стека Heap всё, что положил вызов, в том числе при исключении
+class StackScope {
+public:
+  StackScope(Heap &heap, Value *base) : heap_(heap), base_(base) {}
+  ~StackScope() { heap_.PopTo(base_); }
+
+private:
+  Heap &heap_;
+  Value *base_;
+};
+
+// Выполняет вызов лямбды: base[0] - замыкание, за ним на вершине стека Heap
+// лежат аргументы. Слоты кадра продолжают аргументы на том же стеке, в кучу
+// уходят только захватываемые кадры. Хвостовые вызовы из тела выполняются
+// здесь же в цикле: новая функция с аргументами сдвигается на место base.
+// Арность проверяется вызывающим. Не встраивается, чтобы не увеличивать
+// кадр вызывающего на каждом уровне рекурсии. Для профилировщика каждый
+// хвостовой вызов - выход из прежней лямбды и вход в новую
+SCHEME_NOINLINE Value RunLambda(Heap &heap, Value *base) {
+  CallDepthGuard guard;
+  StackScope scope(heap, base);
+  TailCall tail;
+  while (true) {
+    // Всё живое лежит на стеке Heap и в корнях интерпретатора
+    heap.SafePoint();
+    auto *fn = static_cast<LambdaFunc *>(base->GetObject());
+    ++RuntimeCounters::Current().lambda_calls;
+    if (auto profiler = Profiler::Current()) {
+      profiler->Enter(fn);
+    }
+    const LambdaCode &code = *fn->code_;
+    auto argc = static_cast<uint32_t>(heap.StackTop() - base - 1);
+    Env env;
+    env.heap = &heap;
+    env.parent = fn->env_;
+    env.globals = fn->globals_;
+    env.tail = &tail;
+    if (code.heap_frame) {
+      auto *frame = Frame::Create(code.frame_size, fn->env_);
+      std::copy(base + 1, base + 1 + argc, frame->Slots());
+      // Кадр держится слотом над функцией, пока идёт вызов
+      heap.PopTo(base + 1);
+      *heap.Push(1) = frame;
+      env.frame = frame;
+      env.slots = frame->Slots();
+    } else {
+      heap.Push(code.frame_size - argc);
+      env.slots = base + 1;
+    }
+    auto result = ExecuteBody(code, env);
+    if (auto profiler = Profiler::Current()) {
+      profiler->Exit();
+    }
+    if (!tail.callee) {
+      return result;
+    }
+    auto *top = heap.StackTop();
+    std::copy(tail.callee, top, base);
+    heap.PopTo(base + (top - tail.callee));
+    tail.callee = nullptr;
+  }
+}
+
+
+void CheckArity(const LambdaFunc &fn, size_t argc) {
+  if (argc != fn.code_->params.size()) {
+    throw RuntimeError("Wrong number of arguments for lambda function");
+  }
+}
+
+} // namespace
+
+//// Выполнение скомпилированных нод
+ConstantNode::ConstantNode(Value value)
+    : value_(std::move(value)) {}
+Value ConstantNode::Execute(const Env &env) { return value_; }
+
+VariableNode::VariableNode(uint32_t depth, uint32_t slot)
+    : depth_(depth), slot_(slot) {}
+Value VariableNode::Execute(const Env &env) {
+  if (depth_ == 0) {
+    return env.slots[slot_];
+  }
+  return OuterSlot(env, depth_, slot_);
+}
+
+void GlobalSlot::Resolve(Scope *globals) {
+  cell = globals->Find(id);
+  if (!cell) {
+    throw NameError("Naming error");
+  }
+}
+
+Value &GlobalSlot::Assign(Scope *globals) {
+  if (!cell) {
+    cell = globals->Find(id);
+    if (!cell) {
+      throw NameError("Can't find variable");
+    }
+  }
+  return *cell;
+}
+
+Value &GlobalSlot::Bind(Scope *globals) {
+  if (!cell) {
+    cell = &globals->scope_[id];
+  }
+  return *cell;
+}
+
+GlobalVariableNode::GlobalVariableNode(SymbolId id) : slot_(id) {}
+Value GlobalVariableNode::Execute(const Env &env) {
+  return slot_.Lookup(env.globals);
+}
+
+CallNode::CallNode(NodePtr op, std::vector<NodePtr> args)
+    : op_(std::move(op)), args_(std::move(args)) {}
+// Функция и аргументы вычисляются сразу на стек Heap: для лямбды они
+// становятся первыми слотами её кадра, для встроенной функции - срезом ArgList.
+// При исключении стек срезает ближайший RunLambda или Scheme::EvaluateExpr
+Value CallNode::Execute(const Env &env) {
+  auto &heap = *env.heap;
+  auto *base = heap.Push(1 + args_.size());
+  base[0] = op_->Execute(env);
+  auto *callee = base[0].GetObject();
+  if (auto lambda = As<LambdaFunc>(callee)) {
+    CheckArity(*lambda, args_.size());
+    for (size_t i = 0; i < args_.size(); ++i) {
+      base[1 + i] = args_[i]->Execute(env);
+    }
+    if (tail_ && env.tail) {
+      // Вызов выполнит цикл в RunLambda уже после выхода из текущего тела
+      env.tail->callee = base;
+      return nullptr;
+    }
+    return RunLambda(heap, base);
+  }
+  auto fn = As<Function>(callee);
+  if (!fn) {
+    throw RuntimeError("first element must be a function");
+  }
+  for (size_t i = 0; i < args_.size(); ++i) {
+    base[1 + i] = args_[i]->Execute(env);
+  }
+  ++RuntimeCounters::Current().builtin_calls;
+  auto profiler = Profiler::Current();
+  if (profiler) {
+    profiler->Enter(fn);
+  }
+  auto result = fn->Apply(ArgList(base + 1, args_.size()));
+  if (profiler) {
+    profiler->Exit();
+  }
+  heap.PopTo(base);
+  return result;
+}
+void CallNode::MarkTail() { tail_ = true; }
+
+IfNode::IfNode(NodePtr condition, NodePtr true_branch, NodePtr false_branch)
+    : condition_(std::move(condition)), true_branch_(std::move(true_branch)),
+      false_branch_(std::move(false_branch)) {}
+Value IfNode::Execute(const Env &env) {
+  if (IsTrue(condition_->Execute(env))) {
+    return true_branch_->Execute(env);
+  } else if (false_branch_) {
+    return false_branch_->Execute(env);
+  }
+  return nullptr;
+}
+void IfNode::MarkTail() {
+  true_branch_->MarkTail();
+  if (false_branch_) {
+    false_branch_->MarkTail();
+  }
+}
+
+AssignNode::AssignNode(uint32_t depth, uint32_t slot, NodePtr value,
+                       Value result)
+    : depth_(depth), slot_(slot), value_(std::move(value)),
+      result_(std::move(result)) {}
+Value AssignNode::Execute(const Env &env) {
+  auto value = value_->Execute(env);
+  if (depth_ == 0) {
+    env.slots[slot_] = std::move(value);
+  } else {
+    OuterSlot(env, depth_, slot_) = std::move(value);
+  }
+  return result_;
+}
+
+DefineNode::DefineNode(SymbolId id, NodePtr value,
+                       Value result)
+    : slot_(id), value_(std::move(value)), result_(std::move(result)) {}
+Value DefineNode::Execute(const Env &env) {
+  auto value = value_->Execute(env);
+  slot_.Bind(env.globals) = value;
+  return result_;
+}
+
+SetNode::SetNode(SymbolId id, NodePtr value, Value result)
+    : slot_(id), value_(std::move(value)), result_(std::move(result)) {}
+Value SetNode::Execute(const Env &env) {
+  auto value = value_->Execute(env);
+  slot_.Assign(env.globals) = value;
+  return result_;
+}
+
+AndNode::AndNode(std::vector<NodePtr> args) : args_(std::move(args)) {}
+Value AndNode::Execute(const Env &env) {
+  if (args_.empty()) {
+    return Value::Bool(true);
+  }
+  for (size_t i = 0; i + 1 < args_.size(); ++i) {
+    auto value = args_[i]->Execute(env);
+    if (!IsTrue(value)) {
+      return value;
+    }
+  }
+  return args_.back()->Execute(env);
+}
+void AndNode::MarkTail() {
+  if (!args_.empty()) {
+    args_.back()->MarkTail();
+  }
+}
+
+OrNode::OrNode(std::vector<NodePtr> args) : args_(std::move(args)) {}
+Value OrNode::Execute(const Env &env) {
+  if (args_.empty()) {
+    return Value::Bool(false);
+  }
+  for (size_t i = 0; i + 1 < args_.size(); ++i) {
+    auto value = args_[i]->Execute(env);
+    if (IsTrue(value)) {
+      return value;
+    }
+  }
+  return args_.back()->Execute(env);
+}
+void OrNode::MarkTail() {
+  if (!args_.empty()) {
+    args_.back()->MarkTail();
+  }
+}
+
+LambdaNode::LambdaNode(std::shared_ptr<LambdaCode> code)
+    : code_(std::move(code)) {}
+Value LambdaNode::Execute(const Env &env) {
+  auto new_func = New<LambdaFunc>();
+  new_func->code_ = code_;
+  new_func->env_ = env.frame;
+  new_func->globals_ = env.globals;
+  return new_func;
+}
+void LambdaNode::NameLambda(SymbolNode *name) {
+  if (!code_->name) {
+    code_->name = name;
+  }
+}
+
+ProfileNode::ProfileNode(NodePtr expr) : expr_(std::move(expr)) {}
+Value ProfileNode::Execute(const Env &env) {
+  ProfileSession session;
+  auto result = expr_->Execute(env);
+  session.Finish(env.globals);
+  return result;
+}
+
+Value LambdaFunc::Apply(ArgList args) {
+  CheckArity(*this, args.size());
+  auto &heap = Heap::Current();
+  auto *base = heap.Push(1 + args.size());
+  base[0] = this;
+  std::copy(args.begin(), args.end(), base + 1);
+  return RunLambda(heap, base);
+}
+////
+
+//// Компилятор
+Compiler::Compiler(std::shared_ptr<Scope> global_scope)
+    : global_scope_(std::move(global_scope)) {}
+
+Compiler::Resolution Compiler::Resolve(SymbolId id) {
+  for (size_t i = scopes_.size(); i-- > 0;) {
+    auto &names = scopes_[i].names;
+    auto it = std::find(names.begin(), names.end(), id);
+    if (it != names.end()) {
+      uint32_t depth = scopes_.size() - 1 - i;
+      // Цепочка до кадра с переменной должна жить в куче
+      for (size_t j = i; j + 1 < scopes_.size(); ++j) {
+        scopes_[j].code->heap_frame = true;
+      }
+      return Resolution{false, depth,
+                        static_cast<uint32_t>(it - names.begin())};
+    }
+  }
+  return Resolution{true, 0, 0};
+}
+
+Syntax *Compiler::FindSyntax(const Value &head) {
+  auto symbol = AsSymbol(head);
+  if (!symbol || !Resolve(symbol->GetId()).global) {
+    return nullptr;
+  }
+  auto it = global_scope_->scope_.find(symbol->GetId());
+  if (it == global_scope_->scope_.end()) {
+    return nullptr;
+  }
+  return As<Syntax>(it->second.GetObject());
+}
+
+NodePtr Compiler::Compile(const Value &expr) {
+  if (auto symbol = AsSymbol(expr)) {
+    auto resolution = Resolve(symbol->GetId());
+    if (resolution.global) {
+      return std::make_unique<GlobalVariableNode>(symbol->GetId());
+    }
+    return std::make_unique<VariableNode>(resolution.depth, resolution.slot);
+  }
+  auto cell = AsCell(expr);
+  if (!cell) {
+    return std::make_unique<ConstantNode>(expr);
+  }
+  auto form = ToVector(expr);
+  if (auto syntax = FindSyntax(form[0])) {
+    form.erase(form.begin());
+    return syntax->Compile(this, form);
+  }
+  auto op = Compile(form[0]);
+  return std::make_unique<CallNode>(std::move(op), CompileAll(form, 1));
+}
+
+std::vector<NodePtr>
+Compiler::CompileAll(const std::vector<Value> &exprs,
+                     size_t from) {
+  std::vector<NodePtr> nodes;
+  nodes.reserve(exprs.size() - std::min(from, exprs.size()));
+  for (size_t i = from; i < exprs.size(); ++i) {
+    nodes.push_back(Compile(exprs[i]));
+  }
+  return nodes;
+}
+
+// Внутренние define получают слоты заранее, чтобы на них можно было
+// ссылаться из тела до самого define (взаимная рекурсия)
+void Compiler::DeclareInternalDefines(
+    const std::vector<Value> &body, size_t from) {
+  auto &names = scopes_.back().names;
+  for (size_t i = from; i < body.size(); ++i) {
+    auto form = AsCell(body[i]);
+    if (!form || !dynamic_cast<Define *>(FindSyntax(form->GetFirst()))) {
+      continue;
+    }
+    auto target = AsCell(form->GetSecond());
+    if (!target) {
+      continue;
+    }
+    auto name = AsSymbol(target->GetFirst());
+    if (auto signature = AsCell(target->GetFirst())) {
+      name = AsSymbol(signature->GetFirst());
+    }
+    if (name &&
+        std::find(names.begin(), names.end(), name->GetId()) == names.end()) {
+      names.push_back(name->GetId());
+    }
+  }
+}
+
+std::shared_ptr<LambdaCode>
+Compiler::CompileLambda(const Value &params,
+                        const std::vector<Value> &body,
+                        size_t body_from) {
+  if (params && !IsCell(params)) {
+    throw SyntaxError("Lambda parameters must be a list");
+  }
+  auto code = std::make_shared<LambdaCode>();
+  for (auto &param : ToVector(params)) {
+    auto symbol = AsSymbol(param);
+    if (!symbol) {
+      throw SyntaxError("Lambda parameter must be a symbol");
+    }
+    code->params.push_back(symbol->GetId());
+  }
+  scopes_.push_back(LambdaScope{code->params, code.get()});
+  DeclareInternalDefines(body, body_from);
+  code->body = CompileAll(body, body_from);
+  code->body.back()->MarkTail();
+  code->frame_size = scopes_.back().names.size();
+  scopes_.pop_back();
+  return code;
+}
+
+NodePtr Compiler::CompileDefine(SymbolId id, NodePtr value,
+                                Value result) {
+  if (scopes_.empty()) {
+    return std::make_unique<DefineNode>(id, std::move(value),
+                                        std::move(result));
+  }
+  auto &names = scopes_.back().names;
+  auto it = std::find(names.begin(), names.end(), id);
+  uint32_t slot = it - names.begin();
+  if (it == names.end()) {
+    names.push_back(id);
+  }
+  return std::make_unique<AssignNode>(0, slot, std::move(value),
+                                      std::move(result));
+}
+
+NodePtr Compiler::CompileSet(SymbolId id, NodePtr value,
+                             Value result) {
+  auto resolution = Resolve(id);
+  if (resolution.global) {
+    return std::make_unique<SetNode>(id, std::move(value), std::move(result));
+  }
+  return std::make_unique<AssignNode>(resolution.depth, resolution.slot,
+                                      std::move(value), std::move(result));
+}
+////
+
+//// Компиляция особых форм
+NodePtr Quote::Compile(Compiler *compiler,
+                       const std::vector<Value> &args) {
+  if (args.size() != 1) {
+    throw SyntaxError("Wrong size for list");
+  }
+  return std::make_unique<ConstantNode>(args[0]);
+}
+
+NodePtr If::Compile(Compiler *compiler,
+                    const std::vector<Value> &args) {
+  if (args.size() < 2 || args.size() > 3) {
+    throw SyntaxError("Incorrect number of arguments");
+  }
+  NodePtr false_branch;
+  if (args.size() == 3) {
+    false_branch = compiler->Compile(args[2]);
+  }
+  return std::make_unique<IfNode>(compiler->Compile(args[0]),
+                                  compiler->Compile(args[1]),
+                                  std::move(false_branch));
+}
+
+NodePtr Define::Compile(Compiler *compiler,
+                        const std::vector<Value> &args) {
+  if (args.size() < 2) {
+    throw SyntaxError("not enough arguments");
+  }
+  if (auto symbol = AsSymbol(args[0])) {
+    if (args.size() != 2) {
+      throw SyntaxError("too many arguments");
+    }
+    auto value = compiler->Compile(args[1]);
+    value->NameLambda(symbol);
+    return compiler->CompileDefine(symbol->GetId(), std::move(value),
+                                   Value(this));
+  } else if (auto signature = AsCell(args[0])) {
+    auto name = AsSymbol(signature->GetFirst());
+    if (!name) {
+      throw SyntaxError("Function name must be a symbol");
+    }
+    auto code = compiler->CompileLambda(signature->GetSecond(), args, 1);
+    code->name = name;
+    return compiler->CompileDefine(
+        name->GetId(), std::make_unique<LambdaNode>(code), Value(this));
+  }
+  throw SyntaxError("Can't define non-symbol");
+}
+
+NodePtr Set::Compile(Compiler *compiler,
+                     const std::vector<Value> &args) {
+  if (args.size() != 2) {
+    throw SyntaxError("not enough arguments");
+  }
+  auto symbol = AsSymbol(args[0]);
+  if (!symbol) {
+    throw SyntaxError("Can't set non-symbol");
+  }
+  return compiler->CompileSet(symbol->GetId(), compiler->Compile(args[1]),
+                              Value(this));
+}
+
+NodePtr And::Compile(Compiler *compiler,
+                     const std::vector<Value> &args) {
+  return std::make_unique<AndNode>(compiler->CompileAll(args));
+}
+
+NodePtr Or::Compile(Compiler *compiler,
+                    const std::vector<Value> &args) {
+  return std::make_unique<OrNode>(compiler->CompileAll(args));
+}
+
+NodePtr Lambda::Compile(Compiler *compiler,
+                        const std::vector<Value> &args) {
+  if (args.size() < 2) {
+    throw SyntaxError("Invalid number of arguments in lambda function");
+  }
+  return std::make_unique<LambdaNode>(
+      compiler->CompileLambda(args[0], args, 1));
+}
+
+NodePtr Profile::Compile(Compiler *compiler,
+                         const std::vector<Value> &args) {
+  if (args.size() != 1) {
+    throw SyntaxError("profile expects one expression");
+  }
+  return std::make_unique<ProfileNode>(compiler->Compile(args[0]));
+}
+////
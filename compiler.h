@@ -0,0 +1,318 @@
+#pragma once
+
+#include "gc.h"
+#include "parser.h"
+#include <memory>
+#include <vector>
+
+class BytecodeEmitter;
+class ImageWriter;
+struct BytecodeProto;
+
+//// Окружение выполнения
+// Локальные переменные адресуются парой (depth, slot): depth == 0 - слоты
+// текущей лямбды, иначе depth - 1 шагов по цепочке parent от захваченного кадра.
+// Глобальные живут в отдельной таблице Scope. Слоты кадров, не попавших в
+// кучу, лежат на стеке значений Heap вместе с функцией вызова
+
+// Отложенный вызов из хвостовой позиции: выполняется циклом в вызывающей
+// лямбде вместо рекурсии, так что хвостовые циклы не растят стек.
+// Функция и аргументы лежат на стеке Heap, начиная с callee
+struct TailCall {
+    Value* callee = nullptr;
+};
+
+struct Env {
+    Heap* heap = nullptr;
+    Value* slots = nullptr;
+    // Кадр текущей лямбды, если он в куче (его захватывают вложенные лямбды)
+    Frame* frame = nullptr;
+    // Кадр, захваченный вызванным замыканием
+    Frame* parent = nullptr;
+    Scope* globals = nullptr;
+    // Куда складывать хвостовой вызов; nullptr вне тела лямбды
+    TailCall* tail = nullptr;
+};
+
+// Кэш глобальной переменной в месте обращения: адрес ячейки Scope ищется
+// в таблице один раз. define и set! пишут в ту же ячейку, поэтому адрес
+// не устаревает и сбрасывать его не нужно. Исключение - Scheme::Reset:
+// он удаляет ячейки пользовательских определений, но весь код, который
+// мог их закэшировать, после Reset уже недостижим
+struct GlobalSlot {
+    explicit GlobalSlot(SymbolId id) : id(id) {
+    }
+
+    // Ячейка определённой переменной, иначе NameError
+    Value& Lookup(Scope* globals) {
+        if (!cell) {
+            Resolve(globals);
+        }
+        return *cell;
+    }
+    // Ячейка для set!: переменная должна быть определена
+    Value& Assign(Scope* globals);
+    // Ячейка для define: создаётся, если переменной ещё нет
+    Value& Bind(Scope* globals);
+
+    SymbolId id;
+    Value* cell = nullptr;
+
+private:
+    void Resolve(Scope* globals);
+};
+
+inline Value& OuterSlot(const Env& env, uint32_t depth, uint32_t slot) {
+    Frame* frame = env.parent;
+    for (uint32_t i = 1; i < depth; ++i) {
+        frame = frame->Parent();
+    }
+    return frame->Slots()[slot];
+}
+////
+
+//// Скомпилированное дерево
+// Compile один раз разбирает прочитанное S-выражение: особые формы раскрываются,
+// переменные разрешаются в слоты кадров или глобальные, вызовы получают готовый
+// массив аргументов, и повторное выполнение не ходит по спискам
+class CompiledNode {
+public:
+    virtual ~CompiledNode() = default;
+    virtual Value Execute(const Env& env) = 0;
+    virtual void Emit(BytecodeEmitter* emitter) = 0;
+    // Отмечает константы ноды и код вложенных лямбд
+    virtual void Trace(Heap* heap) = 0;
+    // Пишет ноду в образ кучи (image.h)
+    virtual void Save(ImageWriter* image) = 0;
+    // Отмечает ноду как стоящую в хвостовой позиции тела лямбды
+    virtual void MarkTail() {
+    }
+    // Даёт имя из define лямбде, которую создаёт нода (для профилировщика)
+    virtual void NameLambda(SymbolNode* name) {
+    }
+};
+
+typedef std::unique_ptr<CompiledNode> NodePtr;
+
+class ConstantNode : public CompiledNode {
+public:
+    explicit ConstantNode(Value value);
+    Value Execute(const Env& env) override;
+    void Emit(BytecodeEmitter* emitter) override;
+    void Trace(Heap* heap) override;
+    void Save(ImageWriter* image) override;
+
+private:
+    Value value_;
+};
+
+class VariableNode : public CompiledNode {
+public:
+    VariableNode(uint32_t depth, uint32_t slot);
+    Value Execute(const Env& env) override;
+    void Emit(BytecodeEmitter* emitter) override;
+    void Trace(Heap* heap) override;
+    void Save(ImageWriter* image) override;
+
+private:
+    uint32_t depth_;
+    uint32_t slot_;
+};
+
+class GlobalVariableNode : public CompiledNode {
+public:
+    explicit GlobalVariableNode(SymbolId id);
+    Value Execute(const Env& env) override;
+    void Emit(BytecodeEmitter* emitter) override;
+    void Trace(Heap* heap) override;
+    void Save(ImageWriter* image) override;
+
+private:
+    GlobalSlot slot_;
+};
+
+class CallNode : public CompiledNode {
+public:
+    CallNode(NodePtr op, std::vector<NodePtr> args);
+    Value Execute(const Env& env) override;
+    void Emit(BytecodeEmitter* emitter) override;
+    void Trace(Heap* heap) override;
+    void Save(ImageWriter* image) override;
+    void MarkTail() override;
+
+private:
+    NodePtr op_;
+    std::vector<NodePtr> args_;
+    bool tail_ = false;
+};
+
+class IfNode : public CompiledNode {
+public:
+    IfNode(NodePtr condition, NodePtr true_branch, NodePtr false_branch);
+    Value Execute(const Env& env) override;
+    void Emit(BytecodeEmitter* emitter) override;
+    void Trace(Heap* heap) override;
+    void Save(ImageWriter* image) override;
+    void MarkTail() override;
+
+private:
+    NodePtr condition_;
+    NodePtr true_branch_;
+    NodePtr false_branch_;
+};
+
+// Присваивание локальной переменной: set! и define внутри тела лямбды
+class AssignNode : public CompiledNode {
+public:
+    AssignNode(uint32_t depth, uint32_t slot, NodePtr value, Value result);
+    Value Execute(const Env& env) override;
+    void Emit(BytecodeEmitter* emitter) override;
+    void Trace(Heap* heap) override;
+    void Save(ImageWriter* image) override;
+
+private:
+    uint32_t depth_;
+    uint32_t slot_;
+    NodePtr value_;
+    Value result_;
+};
+
+class DefineNode : public CompiledNode {
+public:
+    DefineNode(SymbolId id, NodePtr value, Value result);
+    Value Execute(const Env& env) override;
+    void Emit(BytecodeEmitter* emitter) override;
+    void Trace(Heap* heap) override;
+    void Save(ImageWriter* image) override;
+
+private:
+    GlobalSlot slot_;
+    NodePtr value_;
+    Value result_;
+};
+
+class SetNode : public CompiledNode {
+public:
+    SetNode(SymbolId id, NodePtr value, Value result);
+    Value Execute(const Env& env) override;
+    void Emit(BytecodeEmitter* emitter) override;
+    void Trace(Heap* heap) override;
+    void Save(ImageWriter* image) override;
+
+private:
+    GlobalSlot slot_;
+    NodePtr value_;
+    Value result_;
+};
+
+class AndNode : public CompiledNode {
+public:
+    explicit AndNode(std::vector<NodePtr> args);
+    Value Execute(const Env& env) override;
+    void Emit(BytecodeEmitter* emitter) override;
+    void Trace(Heap* heap) override;
+    void Save(ImageWriter* image) override;
+    void MarkTail() override;
+
+private:
+    std::vector<NodePtr> args_;
+};
+
+class OrNode : public CompiledNode {
+public:
+    explicit OrNode(std::vector<NodePtr> args);
+    Value Execute(const Env& env) override;
+    void Emit(BytecodeEmitter* emitter) override;
+    void Trace(Heap* heap) override;
+    void Save(ImageWriter* image) override;
+    void MarkTail() override;
+
+private:
+    std::vector<NodePtr> args_;
+};
+
+// Параметры и тело лямбды, общие для всех созданных из неё замыканий.
+// Параметры занимают первые слоты кадра, за ними идут внутренние define
+struct LambdaCode {
+    std::vector<SymbolId> params;
+    std::vector<NodePtr> body;
+    uint32_t frame_size = 0;
+    bool heap_frame = false;
+    std::shared_ptr<BytecodeProto> bytecode;
+    // Имя из define; nullptr у анонимной лямбды
+    SymbolNode* name = nullptr;
+    // Номер сборки, в которой тело уже обойдено
+    uint64_t traced_epoch = 0;
+
+    void Trace(Heap* heap);
+};
+
+class LambdaNode : public CompiledNode {
+public:
+    explicit LambdaNode(std::shared_ptr<LambdaCode> code);
+    Value Execute(const Env& env) override;
+    void Emit(BytecodeEmitter* emitter) override;
+    void Trace(Heap* heap) override;
+    void Save(ImageWriter* image) override;
+    void NameLambda(SymbolNode* name) override;
+
+private:
+    std::shared_ptr<LambdaCode> code_;
+};
+
+// (profile expr): выражение выполняется под профилировщиком (profiler.h).
+// Хвостовая позиция внутрь не передаётся, иначе вызов завершился бы уже
+// после отчёта
+class ProfileNode : public CompiledNode {
+public:
+    explicit ProfileNode(NodePtr expr);
+    Value Execute(const Env& env) override;
+    void Emit(BytecodeEmitter* emitter) override;
+    void Trace(Heap* heap) override;
+    void Save(ImageWriter* image) override;
+
+private:
+    NodePtr expr_;
+};
+////
+
+//// Компилятор
+class Compiler {
+public:
+    explicit Compiler(std::shared_ptr<Scope> global_scope);
+
+    NodePtr Compile(const Value& expr);
+    std::vector<NodePtr> CompileAll(const std::vector<Value>& exprs,
+                                    size_t from = 0);
+    std::shared_ptr<LambdaCode> CompileLambda(const Value& params,
+                                              const std::vector<Value>& body,
+                                              size_t body_from);
+    NodePtr CompileDefine(SymbolId id, NodePtr value, Value result);
+    NodePtr CompileSet(SymbolId id, NodePtr value, Value result);
+
+private:
+    struct LambdaScope {
+        std::vector<SymbolId> names;
+        LambdaCode* code;
+    };
+
+    struct Resolution {
+        bool global;
+        uint32_t depth;
+        uint32_t slot;
+    };
+
+    Resolution Resolve(SymbolId id);
+    Syntax* FindSyntax(const Value& head);
+    void DeclareInternalDefines(const std::vector<Value>& body, size_t from);
+
+    std::shared_ptr<Scope> global_scope_;
+    // Лямбды, внутри которых сейчас идёт компиляция, от внешней к внутренней
+    std::vector<LambdaScope> scopes_;
+};
+////
+
+// Ложно только #f
+inline bool IsTrue(const Value& obj) {
+    return obj != Value::Bool(false);
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "value.h"
+#include <cstdint>
+#include <memory>
+#include <new>
+
+//// Кадр лямбды в куче: слоты лежат сразу за заголовком, одно выделение на кадр.
+// Нужен только лямбдам, чьи переменные видят вложенные замыкания,
+// остальные держат слоты на стеке вызова
+class Frame : public Object {
+public:
+    static Frame* Create(uint32_t size, Frame* parent);
+
+    Value* Slots() {
+        return reinterpret_cast<Value*>(this + 1);
+    }
+    Frame* Parent() {
+        return parent_;
+    }
+    uint32_t Size() const {
+        return size_;
+    }
+
+    void Trace(Heap* heap) override;
+    size_t ByteSize() const override;
+
+    // Память выделена под заголовок вместе со слотами
+    static void operator delete(void* ptr) {
+        ::operator delete(ptr);
+    }
+
+private:
+    Frame(uint32_t size, Frame* parent);
+
+    Frame* parent_;
+    uint32_t size_;
+};
+
+inline Frame* Frame::Create(uint32_t size, Frame* parent) {
+    void* memory = ::operator new(sizeof(Frame) + size * sizeof(Value));
+    auto frame = new (memory) Frame(size, parent);
+    std::uninitialized_value_construct_n(frame->Slots(), size);
+    NoteObjectBytes(frame->Frame::ByteSize());
+    return frame;
+}
+
+inline Frame::Frame(uint32_t size, Frame* parent)
+    : Object(ObjectType::kFrame), parent_(parent), size_(size) {
+}
@@ -0,0 +1,219 @@
+#include "gc.h"
+#include "compiler.h"
+#include "scheme.h"
+#include <algorithm>
+
+namespace {
+
+const size_t kStackSize = 1 << 18;
+// Наименьшее число новых объектов между сборками
+const size_t kMinThreshold = 1 << 17;
+
+} // namespace
+
+Object::Object(ObjectType type) : type_(type) {
+  Heap::Current().Track(this);
+}
+
+void NoteObjectBytes(size_t bytes) { Heap::Current().AddBytes(bytes); }
+
+//// Heap
+Heap &Heap::Current() {
+  thread_local Heap heap;
+  return heap;
+}
+
+Heap::Heap()
+    : threshold_(kMinThreshold), stack_(new Value[kStackSize]),
+      sp_(stack_.get()), stack_end_(stack_.get() + kStackSize) {}
+
+Heap::~Heap() {
+  while (objects_) {
+    auto *obj = objects_;
+    objects_ = obj->next_;
+    delete obj;
+  }
+}
+
+void Heap::AddRoots(RootSet *roots) { roots_.push_back(roots); }
+
+void Heap::RemoveRoots(RootSet *roots) {
+  roots_.erase(std::find(roots_.begin(), roots_.end(), roots));
+}
+
+Value *Heap::Push(size_t count) {
+  if (static_cast<size_t>(stack_end_ - sp_) < count) {
+    throw RuntimeError("Stack overflow");
+  }
+  auto *top = sp_;
+  std::fill(top, top + count, nullptr);
+  sp_ += count;
+  return top;
+}
+
+void Heap::Collect() {
+  ++epoch_;
+  for (auto *roots : roots_) {
+    roots->TraceRoots(this);
+  }
+  Mark(stack_.get(), sp_ - stack_.get());
+  while (!gray_.empty()) {
+    auto *obj = gray_.back();
+    gray_.pop_back();
+    obj->Trace(this);
+  }
+  // Память выживших пересчитывается: их буферы могли вырасти
+  size_t live = 0;
+  size_t bytes = 0;
+  auto **link = &objects_;
+  while (auto *obj = *link) {
+    if (obj->marked_) {
+      obj->marked_ = false;
+      link = &obj->next_;
+      ++live;
+      bytes += obj->ByteSize();
+    } else {
+      *link = obj->next_;
+      delete obj;
+    }
+  }
+  live_ = live;
+  bytes_ = bytes;
+  total_allocated_ += allocated_;
+  allocated_ = 0;
+  threshold_ = std::max(kMinThreshold, live_);
+}
+////
+
+//// Обход объектов
+void CellNode::Trace(Heap *heap) {
+  heap->Mark(number_first_);
+  heap->Mark(number_second_);
+}
+
+void VectorNode::Trace(Heap *heap) {
+  for (auto &element : elements_) {
+    heap->Mark(element);
+  }
+}
+
+void HashTableNode::Trace(Heap *heap) {
+  for (auto &entry : entries_) {
+    if (entry.state == State::kFull) {
+      heap->Mark(entry.key);
+      heap->Mark(entry.value);
+    }
+  }
+}
+
+void LambdaFunc::Trace(Heap *heap) {
+  if (env_) {
+    heap->Mark(env_);
+  }
+  code_->Trace(heap);
+}
+
+void Frame::Trace(Heap *heap) {
+  if (parent_) {
+    heap->Mark(parent_);
+  }
+  heap->Mark(Slots(), size_);
+}
+////
+
+//// Размер объектов
+size_t CellNode::ByteSize() const { return sizeof(*this); }
+
+size_t NumberNode::ByteSize() const {
+  return sizeof(*this) + number_.DigitBytes();
+}
+
+size_t FlonumNode::ByteSize() const { return sizeof(*this); }
+
+size_t VectorNode::ByteSize() const {
+  return sizeof(*this) + elements_.capacity() * sizeof(Value);
+}
+
+size_t HashTableNode::ByteSize() const {
+  return sizeof(*this) + entries_.capacity() * sizeof(Entry);
+}
+
+// Короткий текст лежит в самом std::string, отдельный буфер - только у длинного
+size_t StringNode::ByteSize() const {
+  auto inline_capacity = std::string().capacity();
+  return sizeof(*this) +
+         (value_.capacity() > inline_capacity ? value_.capacity() + 1 : 0);
+}
+
+size_t StringPortNode::ByteSize() const {
+  return sizeof(*this) + buffer_.capacity() + 1;
+}
+
+size_t LambdaFunc::ByteSize() const { return sizeof(*this); }
+
+size_t Frame::ByteSize() const { return sizeof(*this) + size_ * sizeof(Value); }
+////
+
+//// Обход скомпилированного кода: константы и вложенные лямбды
+void LambdaCode::Trace(Heap *heap) {
+  if (traced_epoch == heap->Epoch()) {
+    return;
+  }
+  traced_epoch = heap->Epoch();
+  for (auto &node : body) {
+    node->Trace(heap);
+  }
+}
+
+void ConstantNode::Trace(Heap *heap) { heap->Mark(value_); }
+
+void VariableNode::Trace(Heap *heap) {}
+
+void GlobalVariableNode::Trace(Heap *heap) {}
+
+void CallNode::Trace(Heap *heap) {
+  op_->Trace(heap);
+  for (auto &arg : args_) {
+    arg->Trace(heap);
+  }
+}
+
+void IfNode::Trace(Heap *heap) {
+  condition_->Trace(heap);
+  true_branch_->Trace(heap);
+  if (false_branch_) {
+    false_branch_->Trace(heap);
+  }
+}
+
+void AssignNode::Trace(Heap *heap) {
+  value_->Trace(heap);
+  heap->Mark(result_);
+}
+
+void DefineNode::Trace(Heap *heap) {
+  value_->Trace(heap);
+  heap->Mark(result_);
+}
+
+void SetNode::Trace(Heap *heap) {
+  value_->Trace(heap);
+  heap->Mark(result_);
+}
+
+void AndNode::Trace(Heap *heap) {
+  for (auto &arg : args_) {
+    arg->Trace(heap);
+  }
+}
+
+void OrNode::Trace(Heap *heap) {
+  for (auto &arg : args_) {
+    arg->Trace(heap);
+  }
+}
+
+void LambdaNode::Trace(Heap *heap) { code_->Trace(heap); }
+
+void ProfileNode::Trace(Heap *heap) { expr_->Trace(heap); }
+////
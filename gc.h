@@ -0,0 +1,123 @@
+#pragma once
+
+#include "value.h"
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+//// Куча потока и сборщик мусора mark-and-sweep
+// Все объекты потока связаны в список кучи. Сборка отмечает достижимое из
+// корней и удаляет остальное, так что циклы (замыкание в слоте кадра,
+// который оно же захватило) освобождаются. Объекты не перемещаются.
+// Сборка запускается только в безопасных точках (SafePoint) - на входе в
+// лямбду, где все живые значения лежат в корнях: глобальных таблицах,
+// стеках вычисления и выполняемом коде. Значения, которые C++-код держит
+// у себя между вызовами Scheme::EvaluateExpr, корнями не являются
+class Heap {
+public:
+    // Источник корней: интерпретатор со своей таблицей глобальных и стеком VM
+    class RootSet {
+    public:
+        virtual void TraceRoots(Heap* heap) = 0;
+
+    protected:
+        ~RootSet() = default;
+    };
+
+    static Heap& Current();
+
+    Heap();
+    ~Heap();
+
+    Heap(const Heap&) = delete;
+    Heap& operator=(const Heap&) = delete;
+
+    void AddRoots(RootSet* roots);
+    void RemoveRoots(RootSet* roots);
+
+    void Track(Object* obj) {
+        obj->next_ = objects_;
+        objects_ = obj;
+        ++allocated_;
+        ++live_;
+        ++allocated_by_type_[static_cast<size_t>(obj->type_)];
+    }
+
+    void Mark(Object* obj) {
+        if (!obj->marked_) {
+            obj->marked_ = true;
+            gray_.push_back(obj);
+        }
+    }
+    void Mark(const Value& value) {
+        if (auto obj = value.GetObject()) {
+            Mark(obj);
+        }
+    }
+    void Mark(const Value* values, size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            Mark(values[i]);
+        }
+    }
+
+    void SafePoint() {
+        if (allocated_ >= threshold_) {
+            Collect();
+        }
+    }
+    void Collect();
+
+    // Объекты, созданные за всё время жизни кучи
+    uint64_t Allocations() const {
+        return total_allocated_ + allocated_;
+    }
+    uint64_t Allocations(ObjectType type) const {
+        return allocated_by_type_[static_cast<size_t>(type)];
+    }
+    // Объекты в куче и их память (ByteSize). Считаются при создании и
+    // вычитаются при сборке, так что до сборки сюда входит и мусор.
+    // Буферы, выросшие после создания объекта, учитываются со следующей сборки
+    size_t LiveObjects() const {
+        return live_;
+    }
+    size_t Bytes() const {
+        return bytes_;
+    }
+    void AddBytes(size_t bytes) {
+        bytes_ += bytes;
+    }
+
+    // Номер текущей сборки: общий код обходится один раз за сборку
+    uint64_t Epoch() const {
+        return epoch_;
+    }
+
+    //// Стек значений обходчика дерева: функция и аргументы вызова, слоты
+    // кадров, не попавших в кучу. Выше вершины - мусор, Push обнуляет слоты
+    Value* StackTop() {
+        return sp_;
+    }
+    Value* Push(size_t count);
+    void PopTo(Value* sp) {
+        sp_ = sp;
+    }
+    ////
+
+private:
+    Object* objects_ = nullptr;
+    std::vector<Object*> gray_;
+    std::vector<RootSet*> roots_;
+    // Объекты, созданные после прошлой сборки, и все объекты кучи
+    size_t allocated_ = 0;
+    size_t live_ = 0;
+    size_t bytes_ = 0;
+    size_t threshold_;
+    uint64_t total_allocated_ = 0;
+    uint64_t allocated_by_type_[kObjectTypeCount] = {};
+    uint64_t epoch_ = 0;
+
+    std::unique_ptr<Value[]> stack_;
+    Value* sp_;
+    Value* stack_end_;
+};
+////
@@ -0,0 +1,220 @@
+#include "hash_table.h"
+#include "gc.h"
+#include "parser.h"
+#include <cstring>
+
+namespace {
+
+const size_t kMinCapacity = 8;
+// Сколько элементов структуры участвует в её хеше
+const int kHashBudget = 32;
+
+// Финальное перемешивание MurmurHash3: у адресов и fixnum значимы
+// только некоторые биты, а индекс слота берётся из младших
+size_t Mix(uint64_t x) {
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdULL;
+  x ^= x >> 33;
+  x *= 0xc4ceb9fe1a85ec53ULL;
+  x ^= x >> 33;
+  return x;
+}
+
+size_t Combine(size_t seed, size_t hash) {
+  return seed ^ (hash + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2));
+}
+
+uint64_t DoubleBits(double value) {
+  uint64_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+size_t Hash(const Value &value, int *budget) {
+  --*budget;
+  if (auto number = AsNumber(value)) {
+    return Mix(number->GetValue().Hash());
+  }
+  if (auto flonum = AsFlonum(value)) {
+    return Mix(DoubleBits(flonum->GetValue()));
+  }
+  if (auto string = AsString(value)) {
+    return Mix(std::hash<std::string_view>()(string->GetValue()));
+  }
+  // По номеру, а не по адресу: порядок обхода таблицы не зависит от
+  // размещения символов в памяти
+  if (auto symbol = AsSymbol(value)) {
+    return Mix(symbol->GetId());
+  }
+  if (auto cell = AsCell(value)) {
+    size_t hash = Mix(static_cast<uint64_t>(ObjectType::kCell));
+    Value rest = value;
+    for (; cell && *budget > 0; cell = AsCell(rest)) {
+      hash = Combine(hash, Hash(cell->GetFirst(), budget));
+      rest = cell->GetSecond();
+    }
+    if (!cell) {
+      hash = Combine(hash, Hash(rest, budget));
+    }
+    return hash;
+  }
+  if (auto vector = AsVector(value)) {
+    size_t hash = Mix(static_cast<uint64_t>(ObjectType::kVector));
+    for (size_t i = 0; i < vector->Size() && *budget > 0; ++i) {
+      hash = Combine(hash, Hash(vector->Get(i), budget));
+    }
+    return hash;
+  }
+  return Mix(value.Bits());
+}
+
+} // namespace
+
+//// Равенство и хеш
+bool IsEqual(const Value &lhs, const Value &rhs) {
+  if (lhs == rhs) {
+    return true;
+  }
+  auto left = lhs.GetObject();
+  auto right = rhs.GetObject();
+  if (!left || !right || left->Type() != right->Type()) {
+    return false;
+  }
+  switch (left->Type()) {
+  case ObjectType::kNumber:
+    return Compare(AsNumber(lhs)->GetValue(), AsNumber(rhs)->GetValue()) == 0;
+  case ObjectType::kFlonum:
+    return DoubleBits(AsFlonum(lhs)->GetValue()) ==
+           DoubleBits(AsFlonum(rhs)->GetValue());
+  case ObjectType::kString:
+    return AsString(lhs)->GetValue() == AsString(rhs)->GetValue();
+  case ObjectType::kCell: {
+    // По cdr - циклом, чтобы длинные списки не углубляли рекурсию
+    Value a = lhs;
+    Value b = rhs;
+    while (AsCell(a) && AsCell(b)) {
+      if (!IsEqual(AsCell(a)->GetFirst(), AsCell(b)->GetFirst())) {
+        return false;
+      }
+      a = AsCell(a)->GetSecond();
+      b = AsCell(b)->GetSecond();
+    }
+    return IsEqual(a, b);
+  }
+  case ObjectType::kVector: {
+    auto a = AsVector(lhs);
+    auto b = AsVector(rhs);
+    if (a->Size() != b->Size()) {
+      return false;
+    }
+    for (size_t i = 0; i < a->Size(); ++i) {
+      if (!IsEqual(a->Get(i), b->Get(i))) {
+        return false;
+      }
+    }
+    return true;
+  }
+  default:
+    return false;
+  }
+}
+
+size_t HashValue(const Value &value) {
+  int budget = kHashBudget;
+  return Hash(value, &budget);
+}
+////
+
+//// HashTableNode
+HashTableNode::HashTableNode() : Object(ObjectType::kHashTable) {}
+
+void HashTableNode::PrintTo(std::string *out) {
+  *out += "#<hash-table " + std::to_string(count_) + ">";
+}
+
+size_t HashTableNode::Probe(const Value &key, size_t hash, bool *found) const {
+  auto mask = entries_.size() - 1;
+  auto insert = entries_.size();
+  for (auto index = hash & mask;; index = (index + 1) & mask) {
+    auto &entry = entries_[index];
+    if (entry.state == State::kEmpty) {
+      *found = false;
+      return insert != entries_.size() ? insert : index;
+    }
+    if (entry.state == State::kDeleted) {
+      if (insert == entries_.size()) {
+        insert = index;
+      }
+    } else if (entry.hash == hash && IsEqual(entry.key, key)) {
+      *found = true;
+      return index;
+    }
+  }
+}
+
+Value *HashTableNode::Find(const Value &key) {
+  if (count_ == 0) {
+    return nullptr;
+  }
+  bool found;
+  auto index = Probe(key, HashValue(key), &found);
+  return found ? &entries_[index].value : nullptr;
+}
+
+void HashTableNode::Set(const Value &key, const Value &value) {
+  // Не больше 3/4 слотов заняты записями и надгробиями, так что
+  // пробирование всегда доходит до пустого слота
+  if ((used_ + 1) * 4 > entries_.size() * 3) {
+    auto capacity = kMinCapacity;
+    while (capacity < (count_ + 1) * 2) {
+      capacity *= 2;
+    }
+    Rehash(capacity);
+  }
+  auto hash = HashValue(key);
+  bool found;
+  auto &entry = entries_[Probe(key, hash, &found)];
+  if (!found) {
+    if (entry.state == State::kEmpty) {
+      ++used_;
+    }
+    entry.key = key;
+    entry.hash = hash;
+    entry.state = State::kFull;
+    ++count_;
+  }
+  entry.value = value;
+}
+
+bool HashTableNode::Erase(const Value &key) {
+  if (count_ == 0) {
+    return false;
+  }
+  bool found;
+  auto &entry = entries_[Probe(key, HashValue(key), &found)];
+  if (!found) {
+    return false;
+  }
+  entry = Entry();
+  entry.state = State::kDeleted;
+  --count_;
+  return true;
+}
+
+void HashTableNode::Rehash(size_t capacity) {
+  std::vector<Entry> old(capacity);
+  old.swap(entries_);
+  used_ = count_;
+  auto mask = capacity - 1;
+  for (auto &entry : old) {
+    if (entry.state != State::kFull) {
+      continue;
+    }
+    auto index = entry.hash & mask;
+    while (entries_[index].state != State::kEmpty) {
+      index = (index + 1) & mask;
+    }
+    entries_[index] = std::move(entry);
+  }
+}
+////
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "value.h"
+#include <cstdint>
+#include <vector>
+
+//// Равенство и хеш в смысле equal?
+// Числа равны, если совпадают точность и значение (1 и 1.0 различны),
+// строки, пары и векторы сравниваются по содержимому, остальные объекты - по адресу.
+// Символы интернированы, так что для них это то же, что сравнение имён
+bool IsEqual(const Value& lhs, const Value& rhs);
+// Согласован с IsEqual. У длинных и вложенных структур хешируется только
+// начало, поэтому хеш конечен и для циклических списков
+size_t HashValue(const Value& value);
+////
+
+//// Хеш-таблица с открытой адресацией
+// Записи лежат в одном массиве, ёмкость - степень двойки, коллизии
+// разрешаются линейным пробированием. Удалённая запись становится надгробием,
+// чтобы не рвать цепочки проб; надгробия вычищаются при перестройке.
+// Ключи сравниваются IsEqual
+class HashTableNode : public Object {
+public:
+    HashTableNode();
+    static bool HasType(ObjectType type) {
+        return type == ObjectType::kHashTable;
+    }
+
+    virtual void PrintTo(std::string* out) override;
+    void Trace(Heap* heap) override;
+    size_t ByteSize() const override;
+
+    // nullptr, если ключа нет. Указатель действителен до следующего Set
+    Value* Find(const Value& key);
+    void Set(const Value& key, const Value& value);
+    // Был ли ключ в таблице
+    bool Erase(const Value& key);
+    size_t Count() const {
+        return count_;
+    }
+
+    // Обход по слотам: индексы [0, Capacity()), занятые отмечены Occupied.
+    // Таблица может измениться во время обхода, поэтому индекс проверяют
+    // по Capacity на каждом шаге
+    size_t Capacity() const {
+        return entries_.size();
+    }
+    bool Occupied(size_t index) const {
+        return entries_[index].state == State::kFull;
+    }
+    const Value& KeyAt(size_t index) const {
+        return entries_[index].key;
+    }
+    const Value& ValueAt(size_t index) const {
+        return entries_[index].value;
+    }
+
+private:
+    enum class State : uint8_t { kEmpty, kFull, kDeleted };
+
+    struct Entry {
+        Value key;
+        Value value;
+        size_t hash = 0;
+        State state = State::kEmpty;
+    };
+
+    // Слот с ключом или, если его нет, первый слот, куда ключ можно вставить
+    size_t Probe(const Value& key, size_t hash, bool* found) const;
+    void Rehash(size_t capacity);
+
+    std::vector<Entry> entries_;
+    size_t count_ = 0;
+    // Занятые слоты вместе с надгробиями: по ним считается заполненность
+    size_t used_ = 0;
+};
+////
@@ -0,0 +1,766 @@
+#include "image.h"
+
+#include "scheme.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+const char kMagic[] = "SCMIMG1\n";
+const size_t kMagicSize = sizeof(kMagic) - 1;
+
+enum class NodeTag : uint8_t {
+  kNone,
+  kConstant,
+  kVariable,
+  kGlobalVariable,
+  kCall,
+  kTailCall,
+  kIf,
+  kAssign,
+  kDefine,
+  kSet,
+  kAnd,
+  kOr,
+  kLambda,
+  kProfile,
+};
+
+// Коды значений: непосредственные значения, иначе kFirstObject + номер объекта
+const uint64_t kNullCode = 0;
+const uint64_t kFalseCode = 1;
+const uint64_t kTrueCode = 2;
+const uint64_t kFixnumCode = 3;
+const uint64_t kFirstObject = 4;
+
+void PutNumber(std::string *out, uint64_t number) {
+  while (number >= 0x80) {
+    out->push_back(static_cast<char>(number | 0x80));
+    number >>= 7;
+  }
+  out->push_back(static_cast<char>(number));
+}
+
+void PutString(std::string *out, std::string_view text) {
+  PutNumber(out, text.size());
+  out->append(text);
+}
+
+void PutDouble(std::string *out, double value) {
+  char bytes[sizeof(double)];
+  std::memcpy(bytes, &value, sizeof(double));
+  out->append(bytes, sizeof(double));
+}
+
+// Знаковые числа: малые по модулю отрицательные тоже занимают мало байт
+uint64_t ZigZag(int64_t value) {
+  return (static_cast<uint64_t>(value) << 1) ^
+         static_cast<uint64_t>(value >> 63);
+}
+
+int64_t UnZigZag(uint64_t number) {
+  return static_cast<int64_t>((number >> 1) ^ (~(number & 1) + 1));
+}
+
+void WriteTag(ImageWriter *image, NodeTag tag) {
+  image->WriteByte(static_cast<uint8_t>(tag));
+}
+
+[[noreturn]] void Corrupted() { throw RuntimeError("Corrupted heap image"); }
+
+NodePtr Required(NodePtr node) {
+  if (!node) {
+    Corrupted();
+  }
+  return node;
+}
+
+bool IsBuiltin(const Object *obj) {
+  return obj->Type() == ObjectType::kBuiltin ||
+         obj->Type() == ObjectType::kSyntax;
+}
+} // namespace
+
+//// Запись образа
+ImageWriter::ImageWriter(const std::unordered_map<SymbolId, Value> &builtins) {
+  // У объекта под несколькими именами берётся наименьшее: образ не зависит
+  // от порядка обхода таблицы
+  for (auto &[id, value] : builtins) {
+    auto obj = value.GetObject();
+    if (!obj || !IsBuiltin(obj)) {
+      continue;
+    }
+    auto [it, inserted] = builtin_names_.emplace(obj, id);
+    if (!inserted &&
+        SymbolById(id)->GetName() < SymbolById(it->second)->GetName()) {
+      it->second = id;
+    }
+  }
+}
+
+void ImageWriter::AddGlobal(SymbolId id, const Value &value) {
+  out_ = &globals_;
+  WriteSymbol(id);
+  WriteValue(value);
+  ++global_count_;
+}
+
+std::string ImageWriter::Finish() {
+  // Ссылки объектов и тела лямбд добавляют новые объекты и лямбды в конец
+  size_t next_object = 0;
+  size_t next_code = 0;
+  while (next_object < object_order_.size() ||
+         next_code < code_order_.size()) {
+    out_ = &refs_;
+    while (next_object < object_order_.size()) {
+      WriteRefs(object_order_[next_object++]);
+    }
+    out_ = &code_;
+    while (next_code < code_order_.size()) {
+      WriteLambdaCode(code_order_[next_code++]);
+    }
+  }
+  std::string image(kMagic, kMagicSize);
+  PutNumber(&image, object_order_.size());
+  PutNumber(&image, code_order_.size());
+  image += kinds_;
+  image += code_;
+  image += refs_;
+  PutNumber(&image, global_count_);
+  image += globals_;
+  return image;
+}
+
+void ImageWriter::WriteByte(uint8_t byte) {
+  out_->push_back(static_cast<char>(byte));
+}
+
+void ImageWriter::WriteNumber(uint64_t number) { PutNumber(out_, number); }
+
+void ImageWriter::WriteValue(const Value &value) {
+  if (value.IsNull()) {
+    PutNumber(out_, kNullCode);
+  } else if (value.IsBool()) {
+    PutNumber(out_, value.GetBool() ? kTrueCode : kFalseCode);
+  } else if (value.IsFixnum()) {
+    PutNumber(out_, kFixnumCode);
+    PutNumber(out_, ZigZag(value.GetFixnum()));
+  } else {
+    PutNumber(out_, kFirstObject + Ref(value.GetObject()));
+  }
+}
+
+void ImageWriter::WriteSymbol(SymbolId id) { WriteValue(SymbolById(id)); }
+
+void ImageWriter::WriteNode(CompiledNode *node) {
+  if (node) {
+    node->Save(this);
+  } else {
+    WriteTag(this, NodeTag::kNone);
+  }
+}
+
+void ImageWriter::WriteCode(const std::shared_ptr<LambdaCode> &code) {
+  WriteNumber(CodeRef(code.get()));
+}
+
+uint64_t ImageWriter::Ref(Object *obj) {
+  auto it = objects_.find(obj);
+  if (it != objects_.end()) {
+    return it->second;
+  }
+  // Родитель кадра получает номер раньше: при загрузке кадр создаётся
+  // сразу с ним
+  uint64_t parent = kNullCode;
+  if (obj->Type() == ObjectType::kFrame) {
+    if (auto frame_parent = static_cast<Frame *>(obj)->Parent()) {
+      parent = kFirstObject + Ref(frame_parent);
+    }
+  }
+  auto index = object_order_.size();
+  objects_.emplace(obj, index);
+  object_order_.push_back(obj);
+
+  kinds_.push_back(static_cast<char>(obj->Type()));
+  switch (obj->Type()) {
+  case ObjectType::kNumber:
+    PutString(&kinds_, static_cast<NumberNode *>(obj)->GetValue().ToString());
+    break;
+  case ObjectType::kFlonum:
+    PutDouble(&kinds_, static_cast<FlonumNode *>(obj)->GetValue());
+    break;
+  case ObjectType::kSymbol:
+    PutString(&kinds_, static_cast<SymbolNode *>(obj)->GetName());
+    break;
+  case ObjectType::kVector:
+    PutNumber(&kinds_, static_cast<VectorNode *>(obj)->Size());
+    break;
+  case ObjectType::kS64Vector: {
+    auto &elements = static_cast<S64VectorNode *>(obj)->Elements();
+    PutNumber(&kinds_, elements.size());
+    for (auto element : elements) {
+      PutNumber(&kinds_, ZigZag(element));
+    }
+    break;
+  }
+  case ObjectType::kF64Vector: {
+    auto &elements = static_cast<F64VectorNode *>(obj)->Elements();
+    PutNumber(&kinds_, elements.size());
+    for (auto element : elements) {
+      PutDouble(&kinds_, element);
+    }
+    break;
+  }
+  case ObjectType::kString:
+    PutString(&kinds_, static_cast<StringNode *>(obj)->GetValue());
+    break;
+  case ObjectType::kStringPort:
+    PutString(&kinds_, static_cast<StringPortNode *>(obj)->Buffer());
+    break;
+  case ObjectType::kBuiltin:
+  case ObjectType::kSyntax: {
+    auto name = builtin_names_.find(obj);
+    if (name == builtin_names_.end()) {
+      throw RuntimeError("Can't save builtin in heap image");
+    }
+    PutString(&kinds_, SymbolById(name->second)->GetName());
+    break;
+  }
+  case ObjectType::kLambda:
+    PutNumber(&kinds_, CodeRef(static_cast<LambdaFunc *>(obj)->code_.get()));
+    break;
+  case ObjectType::kFrame:
+    PutNumber(&kinds_, static_cast<Frame *>(obj)->Size());
+    PutNumber(&kinds_, parent);
+    break;
+  case ObjectType::kCell:
+  case ObjectType::kHashTable:
+    break;
+  }
+  return index;
+}
+
+uint64_t ImageWriter::CodeRef(LambdaCode *code) {
+  auto [it, inserted] = codes_.emplace(code, code_order_.size());
+  if (inserted) {
+    code_order_.push_back(code);
+  }
+  return it->second;
+}
+
+void ImageWriter::WriteRefs(Object *obj) {
+  switch (obj->Type()) {
+  case ObjectType::kCell: {
+    auto cell = static_cast<CellNode *>(obj);
+    WriteValue(cell->GetFirst());
+    WriteValue(cell->GetSecond());
+    break;
+  }
+  case ObjectType::kVector:
+    for (auto &element : static_cast<VectorNode *>(obj)->Elements()) {
+      WriteValue(element);
+    }
+    break;
+  case ObjectType::kHashTable: {
+    auto table = static_cast<HashTableNode *>(obj);
+    WriteNumber(table->Count());
+    for (size_t i = 0; i < table->Capacity(); ++i) {
+      if (table->Occupied(i)) {
+        WriteValue(table->KeyAt(i));
+        WriteValue(table->ValueAt(i));
+      }
+    }
+    break;
+  }
+  case ObjectType::kLambda:
+    WriteValue(static_cast<LambdaFunc *>(obj)->env_);
+    break;
+  case ObjectType::kFrame: {
+    auto frame = static_cast<Frame *>(obj);
+    for (uint32_t i = 0; i < frame->Size(); ++i) {
+      WriteValue(frame->Slots()[i]);
+    }
+    break;
+  }
+  default:
+    break;
+  }
+}
+
+void ImageWriter::WriteLambdaCode(LambdaCode *code) {
+  WriteNumber(code->params.size());
+  for (auto id : code->params) {
+    WriteSymbol(id);
+  }
+  WriteNumber(code->frame_size);
+  WriteByte(code->heap_frame);
+  WriteValue(code->name);
+  WriteNumber(code->body.size());
+  for (auto &node : code->body) {
+    WriteNode(node.get());
+  }
+}
+////
+
+//// Запись нод
+void ConstantNode::Save(ImageWriter *image) {
+  WriteTag(image, NodeTag::kConstant);
+  image->WriteValue(value_);
+}
+
+void VariableNode::Save(ImageWriter *image) {
+  WriteTag(image, NodeTag::kVariable);
+  image->WriteNumber(depth_);
+  image->WriteNumber(slot_);
+}
+
+void GlobalVariableNode::Save(ImageWriter *image) {
+  WriteTag(image, NodeTag::kGlobalVariable);
+  image->WriteSymbol(slot_.id);
+}
+
+void CallNode::Save(ImageWriter *image) {
+  WriteTag(image, tail_ ? NodeTag::kTailCall : NodeTag::kCall);
+  image->WriteNode(op_.get());
+  image->WriteNumber(args_.size());
+  for (auto &arg : args_) {
+    image->WriteNode(arg.get());
+  }
+}
+
+void IfNode::Save(ImageWriter *image) {
+  WriteTag(image, NodeTag::kIf);
+  image->WriteNode(condition_.get());
+  image->WriteNode(true_branch_.get());
+  image->WriteNode(false_branch_.get());
+}
+
+void AssignNode::Save(ImageWriter *image) {
+  WriteTag(image, NodeTag::kAssign);
+  image->WriteNumber(depth_);
+  image->WriteNumber(slot_);
+  image->WriteNode(value_.get());
+  image->WriteValue(result_);
+}
+
+void DefineNode::Save(ImageWriter *image) {
+  WriteTag(image, NodeTag::kDefine);
+  image->WriteSymbol(slot_.id);
+  image->WriteNode(value_.get());
+  image->WriteValue(result_);
+}
+
+void SetNode::Save(ImageWriter *image) {
+  WriteTag(image, NodeTag::kSet);
+  image->WriteSymbol(slot_.id);
+  image->WriteNode(value_.get());
+  image->WriteValue(result_);
+}
+
+void AndNode::Save(ImageWriter *image) {
+  WriteTag(image, NodeTag::kAnd);
+  image->WriteNumber(args_.size());
+  for (auto &arg : args_) {
+    image->WriteNode(arg.get());
+  }
+}
+
+void OrNode::Save(ImageWriter *image) {
+  WriteTag(image, NodeTag::kOr);
+  image->WriteNumber(args_.size());
+  for (auto &arg : args_) {
+    image->WriteNode(arg.get());
+  }
+}
+
+void LambdaNode::Save(ImageWriter *image) {
+  WriteTag(image, NodeTag::kLambda);
+  image->WriteCode(code_);
+}
+
+void ProfileNode::Save(ImageWriter *image) {
+  WriteTag(image, NodeTag::kProfile);
+  image->WriteNode(expr_.get());
+}
+////
+
+//// Чтение образа
+// Объекты создаются без безопасных точек: пока образ не загружен целиком,
+// сборка не запускается и недостроенные объекты корнями быть не обязаны
+ImageReader::ImageReader(std::string_view data,
+                         const std::unordered_map<SymbolId, Value> &builtins)
+    : data_(data), builtins_(builtins) {}
+
+void ImageReader::Load(Scope *globals) {
+  if (data_.substr(0, kMagicSize) != std::string_view(kMagic, kMagicSize)) {
+    throw RuntimeError("Not a heap image");
+  }
+  pos_ = kMagicSize;
+  globals_ = globals;
+  // Каждый объект и каждая лямбда занимают в файле хотя бы байт
+  auto object_count = ReadNumber();
+  auto code_count = ReadNumber();
+  if (object_count > data_.size() || code_count > data_.size()) {
+    Corrupted();
+  }
+  codes_.reserve(code_count);
+  for (uint64_t i = 0; i < code_count; ++i) {
+    codes_.push_back(std::make_shared<LambdaCode>());
+  }
+  objects_.reserve(object_count);
+  for (uint64_t i = 0; i < object_count; ++i) {
+    auto type = ReadByte();
+    if (type >= kObjectTypeCount) {
+      Corrupted();
+    }
+    ReadObject(static_cast<ObjectType>(type));
+  }
+  for (auto &code : codes_) {
+    ReadLambdaCode(code.get());
+  }
+  for (auto obj : objects_) {
+    ReadRefs(obj);
+  }
+  for (auto &[table, entry] : entries_) {
+    table->Set(entry.first, entry.second);
+  }
+
+  auto global_count = ReadNumber();
+  std::vector<std::pair<SymbolId, Value>> definitions;
+  for (uint64_t i = 0; i < global_count; ++i) {
+    auto id = ReadSymbol();
+    definitions.emplace_back(id, ReadValue());
+  }
+  if (pos_ != data_.size()) {
+    Corrupted();
+  }
+  // Переменные определяются, только когда образ прочитан без ошибок
+  for (auto &[id, value] : definitions) {
+    globals->scope_[id] = value;
+  }
+}
+
+uint8_t ImageReader::ReadByte() {
+  if (pos_ >= data_.size()) {
+    Corrupted();
+  }
+  return static_cast<uint8_t>(data_[pos_++]);
+}
+
+uint64_t ImageReader::ReadNumber() {
+  uint64_t number = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    auto byte = ReadByte();
+    number |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) {
+      return number;
+    }
+  }
+  Corrupted();
+}
+
+Value ImageReader::ReadValue() {
+  auto code = ReadNumber();
+  switch (code) {
+  case kNullCode:
+    return Value();
+  case kFalseCode:
+    return Value::Bool(false);
+  case kTrueCode:
+    return Value::Bool(true);
+  case kFixnumCode: {
+    auto value = UnZigZag(ReadNumber());
+    if (!Value::FitsFixnum(value)) {
+      Corrupted();
+    }
+    return Value::Fixnum(value);
+  }
+  default:
+    if (code - kFirstObject >= objects_.size()) {
+      Corrupted();
+    }
+    return objects_[code - kFirstObject];
+  }
+}
+
+SymbolId ImageReader::ReadSymbol() {
+  auto symbol = AsSymbol(ReadValue());
+  if (!symbol) {
+    Corrupted();
+  }
+  return symbol->GetId();
+}
+
+NodePtr ImageReader::ReadNode() {
+  auto tag = static_cast<NodeTag>(ReadByte());
+  switch (tag) {
+  case NodeTag::kNone:
+    return nullptr;
+  case NodeTag::kConstant:
+    return std::make_unique<ConstantNode>(ReadValue());
+  case NodeTag::kVariable: {
+    auto depth = ReadNumber();
+    auto slot = ReadNumber();
+    return std::make_unique<VariableNode>(depth, slot);
+  }
+  case NodeTag::kGlobalVariable:
+    return std::make_unique<GlobalVariableNode>(ReadSymbol());
+  case NodeTag::kCall:
+  case NodeTag::kTailCall: {
+    auto op = Required(ReadNode());
+    std::vector<NodePtr> args(ReadNumber());
+    for (auto &arg : args) {
+      arg = Required(ReadNode());
+    }
+    auto node = std::make_unique<CallNode>(std::move(op), std::move(args));
+    if (tag == NodeTag::kTailCall) {
+      node->MarkTail();
+    }
+    return node;
+  }
+  case NodeTag::kIf: {
+    auto condition = Required(ReadNode());
+    auto true_branch = Required(ReadNode());
+    auto false_branch = ReadNode();
+    return std::make_unique<IfNode>(std::move(condition),
+                                    std::move(true_branch),
+                                    std::move(false_branch));
+  }
+  case NodeTag::kAssign: {
+    auto depth = ReadNumber();
+    auto slot = ReadNumber();
+    auto value = Required(ReadNode());
+    return std::make_unique<AssignNode>(depth, slot, std::move(value),
+                                        ReadValue());
+  }
+  case NodeTag::kDefine: {
+    auto id = ReadSymbol();
+    auto value = Required(ReadNode());
+    return std::make_unique<DefineNode>(id, std::move(value), ReadValue());
+  }
+  case NodeTag::kSet: {
+    auto id = ReadSymbol();
+    auto value = Required(ReadNode());
+    return std::make_unique<SetNode>(id, std::move(value), ReadValue());
+  }
+  case NodeTag::kAnd:
+  case NodeTag::kOr: {
+    std::vector<NodePtr> args(ReadNumber());
+    for (auto &arg : args) {
+      arg = Required(ReadNode());
+    }
+    if (tag == NodeTag::kAnd) {
+      return std::make_unique<AndNode>(std::move(args));
+    }
+    return std::make_unique<OrNode>(std::move(args));
+  }
+  case NodeTag::kLambda:
+    return std::make_unique<LambdaNode>(ReadCode());
+  case NodeTag::kProfile:
+    return std::make_unique<ProfileNode>(Required(ReadNode()));
+  }
+  Corrupted();
+}
+
+std::shared_ptr<LambdaCode> ImageReader::ReadCode() {
+  auto index = ReadNumber();
+  if (index >= codes_.size()) {
+    Corrupted();
+  }
+  return codes_[index];
+}
+
+std::string_view ImageReader::ReadString() {
+  auto size = ReadNumber();
+  if (size > data_.size() - pos_) {
+    Corrupted();
+  }
+  auto text = data_.substr(pos_, size);
+  pos_ += size;
+  return text;
+}
+
+double ImageReader::ReadDouble() {
+  if (data_.size() - pos_ < sizeof(double)) {
+    Corrupted();
+  }
+  double value;
+  std::memcpy(&value, data_.data() + pos_, sizeof(double));
+  pos_ += sizeof(double);
+  return value;
+}
+
+void ImageReader::ReadObject(ObjectType type) {
+  Object *obj = nullptr;
+  switch (type) {
+  case ObjectType::kNumber:
+    try {
+      obj = New<NumberNode>(BigInt::Parse(ReadString()));
+    } catch (const std::invalid_argument &) {
+      Corrupted();
+    }
+    break;
+  case ObjectType::kFlonum:
+    obj = New<FlonumNode>(ReadDouble());
+    break;
+  case ObjectType::kSymbol:
+    obj = Intern(ReadString());
+    break;
+  case ObjectType::kCell:
+    obj = New<CellNode>();
+    break;
+  case ObjectType::kVector: {
+    // Каждый элемент займёт в ссылках хотя бы байт
+    auto size = ReadNumber();
+    if (size > data_.size()) {
+      Corrupted();
+    }
+    obj = New<VectorNode>(std::vector<Value>(size));
+    break;
+  }
+  case ObjectType::kS64Vector: {
+    auto size = ReadNumber();
+    if (size > data_.size() - pos_) {
+      Corrupted();
+    }
+    std::vector<int64_t> elements(size);
+    for (auto &element : elements) {
+      element = UnZigZag(ReadNumber());
+    }
+    obj = New<S64VectorNode>(std::move(elements));
+    break;
+  }
+  case ObjectType::kF64Vector: {
+    auto size = ReadNumber();
+    if (size > (data_.size() - pos_) / sizeof(double)) {
+      Corrupted();
+    }
+    std::vector<double> elements(size);
+    for (auto &element : elements) {
+      element = ReadDouble();
+    }
+    obj = New<F64VectorNode>(std::move(elements));
+    break;
+  }
+  case ObjectType::kHashTable:
+    obj = New<HashTableNode>();
+    break;
+  case ObjectType::kString:
+    obj = New<StringNode>(std::string(ReadString()));
+    break;
+  case ObjectType::kStringPort: {
+    auto port = New<StringPortNode>();
+    port->Buffer() = ReadString();
+    obj = port;
+    break;
+  }
+  case ObjectType::kBuiltin:
+  case ObjectType::kSyntax: {
+    auto name = ReadString();
+    auto it = builtins_.find(Intern(name)->GetId());
+    obj = it != builtins_.end() ? it->second.GetObject() : nullptr;
+    if (!obj || obj->Type() != type) {
+      throw RuntimeError("Unknown builtin in heap image: " +
+                         std::string(name));
+    }
+    break;
+  }
+  case ObjectType::kLambda: {
+    auto lambda = New<LambdaFunc>();
+    lambda->code_ = ReadCode();
+    lambda->globals_ = globals_;
+    obj = lambda;
+    break;
+  }
+  case ObjectType::kFrame: {
+    auto size = ReadNumber();
+    if (size > data_.size()) {
+      Corrupted();
+    }
+    auto parent = ReadValue().GetObject();
+    if (parent && parent->Type() != ObjectType::kFrame) {
+      Corrupted();
+    }
+    obj = Frame::Create(size, static_cast<Frame *>(parent));
+    break;
+  }
+  }
+  objects_.push_back(obj);
+}
+
+void ImageReader::ReadRefs(Object *obj) {
+  switch (obj->Type()) {
+  case ObjectType::kCell: {
+    auto cell = static_cast<CellNode *>(obj);
+    cell->SetFirst(ReadValue());
+    cell->SetSecond(ReadValue());
+    break;
+  }
+  case ObjectType::kVector: {
+    auto vector = static_cast<VectorNode *>(obj);
+    for (size_t i = 0; i < vector->Size(); ++i) {
+      vector->Set(i, ReadValue());
+    }
+    break;
+  }
+  case ObjectType::kHashTable: {
+    auto table = static_cast<HashTableNode *>(obj);
+    auto count = ReadNumber();
+    for (uint64_t i = 0; i < count; ++i) {
+      auto key = ReadValue();
+      entries_.emplace_back(table, std::make_pair(key, ReadValue()));
+    }
+    break;
+  }
+  case ObjectType::kLambda: {
+    auto env = ReadValue().GetObject();
+    if (env && env->Type() != ObjectType::kFrame) {
+      Corrupted();
+    }
+    static_cast<LambdaFunc *>(obj)->env_ = static_cast<Frame *>(env);
+    break;
+  }
+  case ObjectType::kFrame: {
+    auto frame = static_cast<Frame *>(obj);
+    for (uint32_t i = 0; i < frame->Size(); ++i) {
+      frame->Slots()[i] = ReadValue();
+    }
+    break;
+  }
+  default:
+    break;
+  }
+}
+
+void ImageReader::ReadLambdaCode(LambdaCode *code) {
+  auto param_count = ReadNumber();
+  if (param_count > data_.size()) {
+    Corrupted();
+  }
+  for (uint64_t i = 0; i < param_count; ++i) {
+    code->params.push_back(ReadSymbol());
+  }
+  code->frame_size = ReadNumber();
+  code->heap_frame = ReadByte();
+  auto name = ReadValue();
+  if (name && !AsSymbol(name)) {
+    Corrupted();
+  }
+  code->name = AsSymbol(name);
+  auto body_size = ReadNumber();
+  for (uint64_t i = 0; i < body_size; ++i) {
+    code->body.push_back(Required(ReadNode()));
+  }
+}
+////
+
+//// (save-image "file")
+Value SaveImageCmd::Apply(ArgList args) {
+  if (args.size() != 1 || !AsString(args[0])) {
+    throw RuntimeError("save-image func expects a file name string");
+  }
+  scheme_->SaveImage(AsString(args[0])->GetValue());
+  return Value(this);
+}
+void SaveImageCmd::PrintTo(std::string *out) {}
+////
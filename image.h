@@ -0,0 +1,121 @@
+#pragma once
+
+#include "compiler.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+class Scheme;
+
+//// Образ кучи
+// (save-image "file") сохраняет глобальные переменные, которые отличаются от
+// начальных встроенных, вместе со всем, что из них достижимо: данными,
+// замыканиями, их кадрами и скомпилированным кодом лямбд. Scheme_Lisp --image
+// восстанавливает их без повторного чтения и компиляции исходника.
+// Объекты кучи нельзя отобразить из файла как есть (у них vtable и свои
+// буферы), поэтому образ - компактные записи, которые читаются за один проход:
+// ссылка - номер в таблице объектов, символ - запись с именем, встроенная
+// функция или особая форма - имя, под которым она лежит в начальной таблице.
+// Формат:
+//   заголовок, число объектов и лямбд;
+//   объекты: вид и всё, что не ссылки (текст, числа, размеры);
+//   код лямбд: параметры и тела нодами CompiledNode;
+//   ссылки объектов: элементы пар, векторов, хеш-таблиц и кадров;
+//   глобальные переменные: пары символ - значение.
+// Числа - varint, вещественные - 8 байт. Загрузка сначала создаёт объекты,
+// потом заполняет ссылки, так что разделяемые и циклические структуры
+// восстанавливаются. Формат файла проверяется, но код лямбд - нет:
+// загружать стоит только свои образы, как и свои исходники
+class ImageWriter {
+public:
+    // builtins: начальные глобальные переменные, по ним называются встроенные объекты
+    explicit ImageWriter(const std::unordered_map<SymbolId, Value>& builtins);
+
+    void AddGlobal(SymbolId id, const Value& value);
+    // Дописывает всё достижимое и возвращает содержимое файла
+    std::string Finish();
+
+    //// Запись нод (CompiledNode::Save)
+    void WriteByte(uint8_t byte);
+    void WriteNumber(uint64_t number);
+    void WriteValue(const Value& value);
+    void WriteSymbol(SymbolId id);
+    // node может быть nullptr (if без ветки else)
+    void WriteNode(CompiledNode* node);
+    void WriteCode(const std::shared_ptr<LambdaCode>& code);
+    ////
+
+private:
+    // Номер объекта в таблице; новый объект получает номер и запись вида
+    uint64_t Ref(Object* obj);
+    uint64_t CodeRef(LambdaCode* code);
+    void WriteRefs(Object* obj);
+    void WriteLambdaCode(LambdaCode* code);
+
+    std::unordered_map<Object*, SymbolId> builtin_names_;
+    std::unordered_map<Object*, uint64_t> objects_;
+    std::unordered_map<LambdaCode*, uint64_t> codes_;
+    // Объекты и лямбды по номерам; ссылки и тела пишутся по порядку номеров
+    std::vector<Object*> object_order_;
+    std::vector<LambdaCode*> code_order_;
+
+    std::string kinds_;
+    std::string code_;
+    std::string refs_;
+    std::string globals_;
+    uint64_t global_count_ = 0;
+    // Раздел, куда идут WriteByte, WriteNumber и WriteValue
+    std::string* out_ = nullptr;
+};
+
+class ImageReader {
+public:
+    ImageReader(std::string_view data, const std::unordered_map<SymbolId, Value>& builtins);
+
+    // Определяет сохранённые переменные в globals; замыкания получают globals.
+    // RuntimeError, если файл не образ или повреждён
+    void Load(Scope* globals);
+
+    //// Чтение нод
+    uint8_t ReadByte();
+    uint64_t ReadNumber();
+    Value ReadValue();
+    SymbolId ReadSymbol();
+    NodePtr ReadNode();
+    std::shared_ptr<LambdaCode> ReadCode();
+    ////
+
+private:
+    std::string_view ReadString();
+    double ReadDouble();
+    void ReadObject(ObjectType type);
+    void ReadRefs(Object* obj);
+    void ReadLambdaCode(LambdaCode* code);
+
+    std::string_view data_;
+    size_t pos_ = 0;
+    const std::unordered_map<SymbolId, Value>& builtins_;
+    Scope* globals_ = nullptr;
+    std::vector<Object*> objects_;
+    std::vector<std::shared_ptr<LambdaCode>> codes_;
+    // Записи хеш-таблиц вставляются, когда заполнены все объекты: хеш ключа
+    // зависит от его содержимого
+    std::vector<std::pair<HashTableNode*, std::pair<Value, Value>>> entries_;
+};
+////
+
+// (save-image "file"): образ глобальных переменных интерпретатора
+class SaveImageCmd : public Function {
+public:
+    explicit SaveImageCmd(Scheme* scheme) : scheme_(scheme) {
+    }
+    Value Apply(ArgList args) override;
+    void PrintTo(std::string* out) override;
+
+private:
+    Scheme* scheme_;
+};
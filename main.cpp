@@ -1,15 +1,173 @@
+#include <algorithm>
 #include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <unistd.h>
 #include "scheme.h"
+#include "mapped_file.h"
+#include "profiler.h"
+#include "server.h"
 
-int main() {
-    Scheme new_scheme;
-    while (true) {
-        std::string line;
-        std::getline(std::cin, line);
+namespace {
+
+// Пакетный режим: один Tokenizer на весь вход, формы читаются и вычисляются подряд.
+// Результаты печатаются прямо в буфер stdout, который сбрасывается блоками
+int RunBatch(Scheme* scheme, Tokenizer* tok) {
+    OutputBuffer output(STDOUT_FILENO);
+    try {
+        while (!tok->IsEnd()) {
+            auto node = Read(tok);
+            auto written = output.Written();
+            PrintTo(scheme->EvaluateExpr(node), &output);
+            if (output.Written() != written) {
+                *output.Buffer() += '\n';
+            }
+            output.MaybeFlush();
+        }
+        output.Flush();
+    } catch (const std::exception& e) {
+        try {
+            output.Flush();
+        } catch (const std::exception&) {
+        }
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+int RunRepl(Scheme* scheme) {
+    std::string line;
+    while (std::getline(std::cin, line)) {
         std::stringstream ss(line);
-        Tokenizer tok(&ss);
-        auto node = Read(&tok);
-        auto eval_node = new_scheme.EvaluateExpr(node);
-        std::cout << Print(eval_node);
+        try {
+            Tokenizer tok(&ss);
+            while (!tok.IsEnd()) {
+                auto node = Read(&tok);
+                std::cout << Print(scheme->EvaluateExpr(node)) << std::endl;
+            }
+        } catch (const std::exception& e) {
+            std::cout << "Error: " << e.what() << std::endl;
+        }
+    }
+    return 0;
+}
+
+// Файл из аргументов, иначе stdin: пакетно или построчно в терминале
+int Run(Scheme* scheme, const char* path) {
+    if (path) {
+        try {
+            MappedFile file(path);
+            Tokenizer tok(file.View());
+            return RunBatch(scheme, &tok);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+    }
+    if (!isatty(STDIN_FILENO)) {
+        std::ios::sync_with_stdio(false);
+        try {
+            Tokenizer tok(&std::cin);
+            return RunBatch(scheme, &tok);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+    }
+    return RunRepl(scheme);
+}
+
+// Режим сервера: запросы кадрами из stdin или по Unix-сокету (server.h)
+int RunServer(size_t workers, Backend backend, const char* socket_path) {
+    if (workers == 0) {
+        workers = std::max(1u, std::thread::hardware_concurrency());
+    }
+    try {
+        Server server(workers, backend);
+        if (socket_path) {
+            server.Listen(socket_path);
+        } else {
+            server.Serve(STDIN_FILENO, STDOUT_FILENO);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    Backend backend = Backend::kTree;
+    const char* path = nullptr;
+    bool profile = false;
+    const char* profile_out = nullptr;
+    bool server = false;
+    size_t workers = 0;
+    const char* socket_path = nullptr;
+    const char* image = nullptr;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--vm") {
+            backend = Backend::kBytecode;
+        } else if (arg == "--server" && i + 1 < argc) {
+            server = true;
+            workers = std::strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--socket" && i + 1 < argc) {
+            server = true;
+            socket_path = argv[++i];
+        } else if (arg == "--image" && i + 1 < argc) {
+            image = argv[++i];
+        } else if (arg == "--profile") {
+            profile = true;
+        } else if (arg == "--profile-out" && i + 1 < argc) {
+            profile_out = argv[++i];
+        } else {
+            path = argv[i];
+        }
+    }
+    if (server) {
+        // Рабочие сбрасывают окружение перед каждым запросом (Scheme::Reset)
+        if (image) {
+            std::cerr << "Error: --image is not supported in server mode" << std::endl;
+            return 1;
+        }
+        return RunServer(workers, backend, socket_path);
+    }
+    // У рабочих сервера свои интерпретаторы, этот нужен только здесь
+    Scheme new_scheme;
+    new_scheme.SetBackend(backend);
+    // Определения из образа (save-image) видны программе как уже выполненные
+    if (image) {
+        try {
+            new_scheme.LoadImage(image);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+    }
+    if (!profile && !profile_out) {
+        return Run(&new_scheme, path);
+    }
+
+    // Профилируется весь запуск; отчёт пишется и после ошибки
+    Profiler profiler;
+    Profiler::Install(&profiler);
+    auto status = Run(&new_scheme, path);
+    Profiler::Install(nullptr);
+    if (profile) {
+        std::cerr << profiler.Report(new_scheme.GetGlobals());
+    }
+    if (profile_out) {
+        std::ofstream out(profile_out);
+        out << profiler.Collapsed(new_scheme.GetGlobals());
+        if (!out) {
+            std::cerr << "Error: can't write " << profile_out << std::endl;
+            return 1;
+        }
     }
+    return status;
 }
@@ -0,0 +1,162 @@
+#include "numeric_kernels.h"
+
+#include "bigint.h"
+
+namespace {
+
+// Независимых аккумуляторов в редукциях: хватает на два AVX-регистра double
+const size_t kLanes = 8;
+
+// Свёртка массива в kLanes аккумуляторах; step(acc, i) добавляет элемент i
+template <class T, class Step, class Merge>
+T Reduce(size_t size, T init, Step step, Merge merge) {
+  T acc[kLanes];
+  for (auto &lane : acc) {
+    lane = init;
+  }
+  size_t i = 0;
+  for (; i + kLanes <= size; i += kLanes) {
+    for (size_t lane = 0; lane < kLanes; ++lane) {
+      acc[lane] = step(acc[lane], i + lane);
+    }
+  }
+  for (; i < size; ++i) {
+    acc[0] = step(acc[0], i);
+  }
+  T result = acc[0];
+  for (size_t lane = 1; lane < kLanes; ++lane) {
+    result = merge(result, acc[lane]);
+  }
+  return result;
+}
+
+// Старшие половины элементов в сумме укладываются в int64, пока элементов
+// меньше 2^32; длинные массивы складываются частями с переносом
+const size_t kWideChunk = size_t(1) << 31;
+
+} // namespace
+
+void AddF64(const double *lhs, const double *rhs, double *out, size_t size) {
+  for (size_t i = 0; i < size; ++i) {
+    out[i] = lhs[i] + rhs[i];
+  }
+}
+
+void MulF64(const double *lhs, const double *rhs, double *out, size_t size) {
+  for (size_t i = 0; i < size; ++i) {
+    out[i] = lhs[i] * rhs[i];
+  }
+}
+
+void AxpyF64(double scale, const double *x, double *y, size_t size) {
+  for (size_t i = 0; i < size; ++i) {
+    y[i] += scale * x[i];
+  }
+}
+
+double SumF64(const double *data, size_t size) {
+  return Reduce<double>(
+      size, 0.0, [data](double acc, size_t i) { return acc + data[i]; },
+      [](double lhs, double rhs) { return lhs + rhs; });
+}
+
+double DotF64(const double *lhs, const double *rhs, size_t size) {
+  return Reduce<double>(
+      size, 0.0,
+      [lhs, rhs](double acc, size_t i) { return acc + lhs[i] * rhs[i]; },
+      [](double lhs, double rhs) { return lhs + rhs; });
+}
+
+double MinF64(const double *data, size_t size) {
+  auto min = [](double lhs, double rhs) { return rhs < lhs ? rhs : lhs; };
+  return Reduce<double>(
+      size, data[0], [data, min](double acc, size_t i) { return min(acc, data[i]); },
+      min);
+}
+
+double MaxF64(const double *data, size_t size) {
+  auto max = [](double lhs, double rhs) { return rhs > lhs ? rhs : lhs; };
+  return Reduce<double>(
+      size, data[0], [data, max](double acc, size_t i) { return max(acc, data[i]); },
+      max);
+}
+
+// Переполнение сложения: знак результата отличается от знаков обоих слагаемых.
+// Признак копится по всем элементам, чтобы цикл остался без ветвлений
+bool AddS64(const int64_t *lhs, const int64_t *rhs, int64_t *out, size_t size) {
+  uint64_t overflow = 0;
+  for (size_t i = 0; i < size; ++i) {
+    auto a = static_cast<uint64_t>(lhs[i]);
+    auto b = static_cast<uint64_t>(rhs[i]);
+    auto sum = a + b;
+    overflow |= (sum ^ a) & (sum ^ b);
+    out[i] = static_cast<int64_t>(sum);
+  }
+  return overflow >> 63;
+}
+
+// Векторного умножения int64 с проверкой переполнения в SSE/AVX2 нет,
+// поэтому умножения скалярные
+bool MulS64(const int64_t *lhs, const int64_t *rhs, int64_t *out, size_t size) {
+  bool overflow = false;
+  for (size_t i = 0; i < size; ++i) {
+    overflow |= MulOverflow(lhs[i], rhs[i], &out[i]);
+  }
+  return overflow;
+}
+
+bool AxpyS64(int64_t scale, const int64_t *x, const int64_t *y, int64_t *out,
+             size_t size) {
+  bool overflow = false;
+  for (size_t i = 0; i < size; ++i) {
+    int64_t product = 0;
+    overflow |= MulOverflow(scale, x[i], &product);
+    overflow |= AddOverflow(product, y[i], &out[i]);
+  }
+  return overflow;
+}
+
+bool DotS64(const int64_t *lhs, const int64_t *rhs, size_t size, int64_t *out) {
+  int64_t sum = 0;
+  for (size_t i = 0; i < size; ++i) {
+    int64_t product;
+    if (MulOverflow(lhs[i], rhs[i], &product) || AddOverflow(sum, product, &sum)) {
+      return true;
+    }
+  }
+  *out = sum;
+  return false;
+}
+
+int64_t MinS64(const int64_t *data, size_t size) {
+  auto min = [](int64_t lhs, int64_t rhs) { return rhs < lhs ? rhs : lhs; };
+  return Reduce<int64_t>(
+      size, data[0], [data, min](int64_t acc, size_t i) { return min(acc, data[i]); },
+      min);
+}
+
+int64_t MaxS64(const int64_t *data, size_t size) {
+  auto max = [](int64_t lhs, int64_t rhs) { return rhs > lhs ? rhs : lhs; };
+  return Reduce<int64_t>(
+      size, data[0], [data, max](int64_t acc, size_t i) { return max(acc, data[i]); },
+      max);
+}
+
+WideSum SumS64(const int64_t *data, size_t size) {
+  WideSum result{0, 0};
+  for (size_t begin = 0; begin < size; begin += kWideChunk) {
+    auto end = size - begin < kWideChunk ? size : begin + kWideChunk;
+    uint64_t low = 0;
+    int64_t high = 0;
+    for (size_t i = begin; i < end; ++i) {
+      low += static_cast<uint32_t>(data[i]);
+      high += data[i] >> 32;
+    }
+    // Перенос из младшей половины, чтобы следующая часть не переполнила low
+    result.low += low & 0xffffffffu;
+    result.high += high + static_cast<int64_t>(low >> 32) +
+                   static_cast<int64_t>(result.low >> 32);
+    result.low &= 0xffffffffu;
+  }
+  return result;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+//// Массовые операции над плотными числовыми массивами
+// Циклы написаны под автовекторизацию (SSE2/AVX - по целевой архитектуре
+// сборки): тело без ветвлений и без зависимостей между итерациями, а
+// редукции идут в нескольких независимых аккумуляторах. Поэтому сумма double
+// векторизуется без -ffast-math, но складывается не строго слева направо,
+// и младшие разряды могут отличаться от последовательного сложения.
+// Операции над int64 сообщают о переполнении так же, как AddOverflow:
+// true - результат не поместился, содержимое out тогда не определено
+
+void AddF64(const double* lhs, const double* rhs, double* out, size_t size);
+void MulF64(const double* lhs, const double* rhs, double* out, size_t size);
+// y += scale * x
+void AxpyF64(double scale, const double* x, double* y, size_t size);
+double SumF64(const double* data, size_t size);
+double DotF64(const double* lhs, const double* rhs, size_t size);
+// Для непустых массивов
+double MinF64(const double* data, size_t size);
+double MaxF64(const double* data, size_t size);
+
+bool AddS64(const int64_t* lhs, const int64_t* rhs, int64_t* out, size_t size);
+bool MulS64(const int64_t* lhs, const int64_t* rhs, int64_t* out, size_t size);
+// out = scale * x + y
+bool AxpyS64(int64_t scale, const int64_t* x, const int64_t* y, int64_t* out, size_t size);
+bool DotS64(const int64_t* lhs, const int64_t* rhs, size_t size, int64_t* out);
+int64_t MinS64(const int64_t* data, size_t size);
+int64_t MaxS64(const int64_t* data, size_t size);
+
+// Точная сумма int64 без переполнения: high * 2^32 + low.
+// Младшие и старшие половины элементов суммируются отдельно, каждая
+// в своём векторном аккумуляторе
+struct WideSum {
+    int64_t high;
+    uint64_t low;
+};
+WideSum SumS64(const int64_t* data, size_t size);
+////
@@ -1,582 +1,591 @@
 #include "parser.h"
 #include "scheme.h"
+#include "numeric_kernels.h"
+#include "runtime_stats.h"
+#include "slab_pool.h"
+#include <charconv>
+#include <cmath>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
 
-/// Evaluate для нод в дереве (вытащить тип ноды из скопа)
-std::shared_ptr<Object> SymbolNode::Evaluate(std::shared_ptr<Scope> scp) {
-  return scp->Lookup(name_);
+//// Пулы нод
+// Пары, числа и строки живут в пулах своего потока. Символы интернированы на весь
+// процесс и не освобождаются, поэтому их пул общий: выделение из него идёт
+// только под блокировкой таблицы символов
+namespace {
+
+SlabPool &CellPool() {
+  thread_local SlabPool pool(sizeof(CellNode));
+  return pool;
+}
+
+SlabPool &NumberPool() {
+  thread_local SlabPool pool(sizeof(NumberNode));
+  return pool;
+}
+
+SlabPool &FlonumPool() {
+  thread_local SlabPool pool(sizeof(FlonumNode));
+  return pool;
+}
+
+SlabPool &StringPool() {
+  thread_local SlabPool pool(sizeof(StringNode));
+  return pool;
 }
-SymbolNode::SymbolNode(std::string name) : name_(name) {}
-void SymbolNode::PrintTo(std::ostream *out) { *out << name_; }
-std::string SymbolNode::GetName() { return name_; }
+
+SlabPool &SymbolPool() {
+  static SlabPool pool(sizeof(SymbolNode));
+  return pool;
+}
+
+} // namespace
+
+void *CellNode::operator new(size_t size) { return CellPool().Allocate(); }
+void CellNode::operator delete(void *ptr) { SlabPool::Free(ptr); }
+void *NumberNode::operator new(size_t size) { return NumberPool().Allocate(); }
+void NumberNode::operator delete(void *ptr) { SlabPool::Free(ptr); }
+void *FlonumNode::operator new(size_t size) { return FlonumPool().Allocate(); }
+void FlonumNode::operator delete(void *ptr) { SlabPool::Free(ptr); }
+void *StringNode::operator new(size_t size) { return StringPool().Allocate(); }
+void StringNode::operator delete(void *ptr) { SlabPool::Free(ptr); }
+void *SymbolNode::operator new(size_t size) { return SymbolPool().Allocate(); }
+void SymbolNode::operator delete(void *ptr) { SlabPool::Free(ptr); }
 ////
 
-std::shared_ptr<Object> CellNode::Evaluate(std::shared_ptr<Scope> scp) {
-  auto base_op = number_first_->Evaluate(scp);
-  auto fn = std::dynamic_pointer_cast<Function>(base_op);
-  auto syntax = std::dynamic_pointer_cast<Syntax>(base_op);
+//// Ноды в дереве
+SymbolNode::SymbolNode(std::string name, SymbolId id)
+    : Object(ObjectType::kSymbol, Permanent{}), name_(std::move(name)), id_(id) {}
+void SymbolNode::PrintTo(std::string *out) { *out += name_; }
+const std::string &SymbolNode::GetName() { return name_; }
+SymbolId SymbolNode::GetId() { return id_; }
+////
 
-  if (!fn && !syntax) {
-    throw RuntimeError("first element must be a function or syntax");
-  }
+//// Интернирование: ключи таблиц ссылаются на имена внутри самих SymbolNode,
+// номер символа - его позиция в by_id.
+// Таблица общая для всех потоков. Перед ней стоит кэш потока: символы, которые
+// поток уже видел, находятся без блокировки, а общая таблица берётся на
+// чтение и лишь для нового символа - на запись
+namespace {
 
-  std::vector<std::shared_ptr<Object>> args = ToVector(number_second_);
-  if (fn) {
-    for (auto &arg : args) {
-      arg = arg->Evaluate(scp);
-    }
-    return fn->Apply(scp, args);
-  }
-  return syntax->Apply(scp, args);
-}
-CellNode::CellNode() {}
-CellNode::CellNode(Object first, Object second)
-    : number_first_(std::make_shared<Object>(first)),
-      number_second_(std::make_shared<Object>(second)) {}
-void CellNode::PrintTo(std::ostream *out) {
-  *out << "(";
-  ::PrintTo(number_first_, out);
-  auto next = std::dynamic_pointer_cast<CellNode>(number_second_);
-  if (!next && number_second_) {
-    *out << " . ";
-    ::PrintTo(number_second_, out);
-  } else {
-    while (next) {
-      *out << " ";
-      ::PrintTo(next->number_first_, out);
-      auto next_obj = std::dynamic_pointer_cast<CellNode>(next->number_second_);
-      if (!next_obj && next->number_second_) {
-        *out << " . ";
-        ::PrintTo(next->number_second_, out);
-      }
-      next = next_obj;
+struct SymbolTable {
+  std::shared_mutex mutex;
+  std::unordered_map<std::string_view, SymbolNode *> by_name;
+  std::vector<SymbolNode *> by_id;
+};
+
+SymbolTable &Symbols() {
+  static SymbolTable table;
+  return table;
+}
+
+SymbolNode *InternShared(std::string_view name) {
+  auto &table = Symbols();
+  {
+    std::shared_lock lock(table.mutex);
+    auto it = table.by_name.find(name);
+    if (it != table.by_name.end()) {
+      return it->second;
     }
   }
-  *out << ")";
+  std::unique_lock lock(table.mutex);
+  auto it = table.by_name.find(name);
+  if (it != table.by_name.end()) {
+    return it->second;
+  }
+  auto symbol = new SymbolNode(std::string(name),
+                               static_cast<SymbolId>(table.by_id.size()));
+  table.by_name.emplace(symbol->GetName(), symbol);
+  table.by_id.push_back(symbol);
+  return symbol;
 }
-auto CellNode::GetFirst() { return number_first_; }
-auto CellNode::GetSecond() { return number_second_; }
-void CellNode::SetFirst(std::shared_ptr<Object> first) {
-  number_first_ = first;
+
+} // namespace
+
+SymbolNode *Intern(std::string_view name) {
+  thread_local std::unordered_map<std::string_view, SymbolNode *> cache;
+  auto it = cache.find(name);
+  if (it != cache.end()) {
+    return it->second;
+  }
+  auto symbol = InternShared(name);
+  cache.emplace(symbol->GetName(), symbol);
+  return symbol;
 }
-void CellNode::SetSecond(std::shared_ptr<Object> second) {
-  number_second_ = second;
+
+SymbolNode *SymbolById(SymbolId id) {
+  auto &table = Symbols();
+  std::shared_lock lock(table.mutex);
+  return table.by_id.at(id);
 }
+////
 
-//// Методы Function
-void Function::PrintTo(std::ostream *out) { *out << "<function>"; }
-std::shared_ptr<Object> Function::Evaluate(std::shared_ptr<Scope> scp) {
-  throw std::runtime_error("can't eval function");
+CellNode::CellNode() : Object(ObjectType::kCell) {}
+CellNode::CellNode(Value first, Value second)
+    : Object(ObjectType::kCell), number_first_(std::move(first)), number_second_(std::move(second)) {}
+void CellNode::PrintTo(std::string *out) { ::PrintTo(Value(this), out); }
+const Value &CellNode::GetFirst() { return number_first_; }
+const Value &CellNode::GetSecond() { return number_second_; }
+void CellNode::SetFirst(Value first) { number_first_ = std::move(first); }
+void CellNode::SetSecond(Value second) { number_second_ = std::move(second); }
+
+namespace {
+
+BigInt ToBigInt(const Value &arg, const char *error) {
+  if (arg.IsFixnum()) {
+    return BigInt(arg.GetFixnum());
+  }
+  if (auto number = AsNumber(arg)) {
+    return number->GetValue();
+  }
+  throw RuntimeError(error);
 }
 
-std::shared_ptr<Object>
-Plus::Apply(const std::shared_ptr<Scope> &scp,
-            const std::vector<std::shared_ptr<Object>> &args) {
-  int64_t value = 0;
-  for (const auto &arg : args) {
-    auto number = std::dynamic_pointer_cast<NumberNode>(arg);
-    if (!number) {
-      throw RuntimeError("Wrong type for plus func value");
+double ToDouble(const Value &arg, const char *error) {
+  if (arg.IsFixnum()) {
+    return static_cast<double>(arg.GetFixnum());
+  }
+  if (auto flonum = AsFlonum(arg)) {
+    return flonum->GetValue();
+  }
+  if (auto number = AsNumber(arg)) {
+    return number->GetValue().ToDouble();
+  }
+  throw RuntimeError(error);
+}
+
+void CheckNumber(const Value &arg, const char *error) {
+  if (!IsNumber(arg)) {
+    throw RuntimeError(error);
+  }
+}
+
+// Результат сравнения с NaN: ни одно из <, =, > не выполняется
+const int kUnordered = 2;
+
+// <0, 0, >0 или kUnordered. Если хотя бы одно число вещественное, сравнение
+// идёт в double, иначе точно; bignum - только когда не оба fixnum
+int CompareNumbers(const Value &lhs, const Value &rhs, const char *error) {
+  if (lhs.IsFixnum() && rhs.IsFixnum()) {
+    auto a = lhs.GetFixnum();
+    auto b = rhs.GetFixnum();
+    return (a > b) - (a < b);
+  }
+  if (AsFlonum(lhs) || AsFlonum(rhs)) {
+    auto a = ToDouble(lhs, error);
+    auto b = ToDouble(rhs, error);
+    if (a != a || b != b) {
+      return kUnordered;
     }
-    value += number->GetValue();
+    return (a > b) - (a < b);
   }
-  return std::make_shared<NumberNode>(value);
+  return Compare(ToBigInt(lhs, error), ToBigInt(rhs, error));
 }
 
-std::shared_ptr<Object>
-Minus::Apply(const std::shared_ptr<Scope> &scp,
-             const std::vector<std::shared_ptr<Object>> &args) {
+// Цепочка сравнений соседних аргументов: (< a b c) = (and (< a b) (< b c))
+template <class Predicate>
+Value CompareChain(ArgList args, const char *error, Predicate predicate) {
+  bool value = true;
   if (!args.empty()) {
-    if (auto number = std::dynamic_pointer_cast<NumberNode>(args[0])) {
-      int64_t value = number->GetValue();
-      for (auto arg = args.begin() + 1; arg != args.end(); ++arg) {
-        number = std::dynamic_pointer_cast<NumberNode>(*arg);
-        if (!number) {
-          throw RuntimeError("Wrong type for minus func value");
-        }
-        value -= number->GetValue();
-      }
-      return std::make_shared<NumberNode>(value);
-    } else {
-      throw RuntimeError("Wrong type for minus func value");
+    CheckNumber(args[0], error);
+    for (size_t i = 1; i < args.size(); ++i) {
+      int order = CompareNumbers(args[i - 1], args[i], error);
+      value = order != kUnordered && predicate(order) && value;
     }
-  } else {
-    throw RuntimeError("Wrong size for minus func value");
   }
+  return Value::Bool(value);
 }
 
-std::shared_ptr<Object>
-Divide::Apply(const std::shared_ptr<Scope> &scp,
-              const std::vector<std::shared_ptr<Object>> &args) {
-  if (!args.empty()) {
-    if (auto number = std::dynamic_pointer_cast<NumberNode>(args[0])) {
-      int64_t value = number->GetValue();
-      for (auto arg = args.begin() + 1; arg != args.end(); ++arg) {
-        number = std::dynamic_pointer_cast<NumberNode>(*arg);
-        if (!number) {
-          throw RuntimeError("Wrong type for divide func value");
-        }
-        value /= number->GetValue();
+// Левая свёртка init op arg1 op arg2 ... в три стадии. Пока операнды fixnum
+// и результат помещается в int64, счёт идёт без выделений; fast возвращает
+// true при переполнении, и дальше продолжает exact над BigInt. С первого
+// вещественного операнда всё считается в double через real. Промежуточные
+// значения не упаковываются, в кучу попадает только результат
+template <class Fast, class Exact, class Real>
+Value FoldNumbers(const Value &init, const Value *begin, const Value *end,
+                  const char *error, Fast fast, Exact exact, Real real) {
+  auto arg = begin;
+  BigInt big;
+  double real_value = 0;
+  bool real_stage = false;
+  if (auto flonum = AsFlonum(init)) {
+    real_value = flonum->GetValue();
+    real_stage = true;
+  } else if (init.IsFixnum()) {
+    int64_t value = init.GetFixnum();
+    for (; arg != end && arg->IsFixnum(); ++arg) {
+      int64_t result;
+      if (fast(value, arg->GetFixnum(), &result)) {
+        break;
       }
-      return std::make_shared<NumberNode>(value);
+      value = result;
+    }
+    if (arg == end) {
+      return MakeInteger(value);
+    }
+    if (AsFlonum(*arg)) {
+      real_value = static_cast<double>(value);
+      real_stage = true;
     } else {
-      throw RuntimeError("Wrong type for divide func value");
+      big = BigInt(value);
     }
   } else {
-    throw RuntimeError("Wrong size for divide func value");
+    big = ToBigInt(init, error);
   }
-}
-
-std::shared_ptr<Object>
-Multiply::Apply(const std::shared_ptr<Scope> &scp,
-                const std::vector<std::shared_ptr<Object>> &args) {
-  int64_t value = 1;
-  for (const auto &arg : args) {
-    auto number = std::dynamic_pointer_cast<NumberNode>(arg);
-    if (!number) {
-      throw RuntimeError("Wrong type for multiply func value");
+  if (!real_stage) {
+    for (; arg != end && !AsFlonum(*arg); ++arg) {
+      big = exact(big, ToBigInt(*arg, error));
     }
-    value *= number->GetValue();
+    if (arg == end) {
+      return MakeInteger(std::move(big));
+    }
+    real_value = big.ToDouble();
+  }
+  for (; arg != end; ++arg) {
+    real_value = real(real_value, ToDouble(*arg, error));
   }
-  return std::make_shared<NumberNode>(value);
+  return MakeFlonum(real_value);
 }
 
-//// Предикаты
-std::shared_ptr<Object>
-Equal::Apply(const std::shared_ptr<Scope> &scp,
-             const std::vector<std::shared_ptr<Object>> &args) {
-  bool value = true;
+void CheckDivisor(bool zero) {
+  if (zero) {
+    throw RuntimeError("Division by zero");
+  }
+}
 
-  if (!args.empty()) {
-    if (auto last_value = std::dynamic_pointer_cast<NumberNode>(args[0])) {
-      for (auto arg = args.begin() + 1; arg != args.end(); ++arg) {
-        auto number = std::dynamic_pointer_cast<NumberNode>(*arg);
-        if (!number) {
-          throw RuntimeError("Wrong type for Equal func value");
-        }
-        value = ((last_value->GetValue() == number->GetValue()) && value);
-        last_value = number;
-      }
-    } else {
-      throw RuntimeError("Wrong type for Equal func value");
-    }
+// Частное или остаток двух целых
+template <class Fast, class Exact>
+Value DivideIntegers(ArgList args, const char *error, Fast fast, Exact exact) {
+  if (args.size() != 2) {
+    throw RuntimeError(error);
+  }
+  if (args[0].IsFixnum() && args[1].IsFixnum()) {
+    CheckDivisor(args[1].GetFixnum() == 0);
+    // |fixnum| < 2^62, поэтому даже частное на -1 помещается в int64
+    return MakeInteger(fast(args[0].GetFixnum(), args[1].GetFixnum()));
   }
-  return std::make_shared<Boolean>(value);
+  auto divisor = ToBigInt(args[1], error);
+  CheckDivisor(divisor.IsZero());
+  return MakeInteger(exact(ToBigInt(args[0], error), divisor));
 }
-std::shared_ptr<Object>
-Greater::Apply(const std::shared_ptr<Scope> &scp,
-               const std::vector<std::shared_ptr<Object>> &args) {
-  bool value = true;
 
-  if (!args.empty()) {
-    if (auto last_value = std::dynamic_pointer_cast<NumberNode>(args[0])) {
-      for (auto arg = args.begin() + 1; arg != args.end(); ++arg) {
-        auto number = std::dynamic_pointer_cast<NumberNode>(*arg);
-        if (!number) {
-          throw RuntimeError("Wrong type for Greater func value");
-        }
-        value = ((last_value->GetValue() > number->GetValue()) && value);
-        last_value = number;
-      }
-    } else {
-      throw RuntimeError("Wrong type for Greater func value");
+// Если среди аргументов есть вещественный, результат тоже вещественный
+template <class Better>
+Value SelectNumber(ArgList args, const char *error, Better better) {
+  CheckNumber(args[0], error);
+  auto best = args[0];
+  bool real = false;
+  for (const auto &arg : args) {
+    real = real || AsFlonum(arg);
+    int order = CompareNumbers(arg, best, error);
+    if (order != kUnordered && better(order)) {
+      best = arg;
     }
   }
-  return std::make_shared<Boolean>(value);
+  if (real && !AsFlonum(best)) {
+    return MakeFlonum(ToDouble(best, error));
+  }
+  return best;
 }
-std::shared_ptr<Object>
-GreaterOrEqual::Apply(const std::shared_ptr<Scope> &scp,
-                      const std::vector<std::shared_ptr<Object>> &args) {
-  bool value = true;
 
-  if (!args.empty()) {
-    if (auto last_value = std::dynamic_pointer_cast<NumberNode>(args[0])) {
-      for (auto arg = args.begin() + 1; arg != args.end(); ++arg) {
-        auto number = std::dynamic_pointer_cast<NumberNode>(*arg);
-        if (!number) {
-          throw RuntimeError("Wrong type for GreaterOrEqual func value");
-        }
-        value = ((last_value->GetValue() >= number->GetValue()) && value);
-        last_value = number;
-      }
-    } else {
-      throw RuntimeError("Wrong type for GreaterOrEqual func value");
-    }
+} // namespace
+
+//// Методы Function
+void Function::PrintTo(std::string *out) { *out += "<function>"; }
+
+Value Plus::Apply(ArgList args) {
+  return FoldNumbers(
+      Value::Fixnum(0), args.begin(), args.end(),
+      "Wrong type for plus func value", AddOverflow,
+      [](const BigInt &lhs, const BigInt &rhs) { return lhs + rhs; },
+      [](double lhs, double rhs) { return lhs + rhs; });
+}
+
+Value Minus::Apply(ArgList args) {
+  if (args.empty()) {
+    throw RuntimeError("Wrong size for minus func value");
   }
-  return std::make_shared<Boolean>(value);
+  return FoldNumbers(
+      args[0], args.begin() + 1, args.end(), "Wrong type for minus func value",
+      SubOverflow,
+      [](const BigInt &lhs, const BigInt &rhs) { return lhs - rhs; },
+      [](double lhs, double rhs) { return lhs - rhs; });
 }
-std::shared_ptr<Object>
-Less::Apply(const std::shared_ptr<Scope> &scp,
-            const std::vector<std::shared_ptr<Object>> &args) {
-  bool value = true;
 
-  if (!args.empty()) {
-    if (auto last_value = std::dynamic_pointer_cast<NumberNode>(args[0])) {
-      for (auto arg = args.begin() + 1; arg != args.end(); ++arg) {
-        auto number = std::dynamic_pointer_cast<NumberNode>(*arg);
-        if (!number) {
-          throw RuntimeError("Wrong type for Less func value");
-        }
-        value = ((last_value->GetValue() < number->GetValue()) && value);
-        last_value = number;
+// Пока целые делятся нацело, частное точное; иначе дальше счёт идёт в
+// double: (/ 7 2) = 3.5. Деление с отбрасыванием дробной части - quotient
+Value Divide::Apply(ArgList args) {
+  const char *error = "Wrong type for divide func value";
+  if (args.empty()) {
+    throw RuntimeError("Wrong size for divide func value");
+  }
+  CheckNumber(args[0], error);
+  Value exact = args[0];
+  size_t i = 1;
+  for (; i < args.size() && !AsFlonum(exact) && !AsFlonum(args[i]); ++i) {
+    // fixnum 63-битные, так что частное двух fixnum не переполняет int64
+    if (exact.IsFixnum() && args[i].IsFixnum()) {
+      auto lhs = exact.GetFixnum();
+      auto rhs = args[i].GetFixnum();
+      CheckDivisor(rhs == 0);
+      if (lhs % rhs != 0) {
+        break;
       }
-    } else {
-      throw RuntimeError("Wrong type for Less func value");
+      exact = MakeInteger(lhs / rhs);
+      continue;
+    }
+    auto lhs = ToBigInt(exact, error);
+    auto rhs = ToBigInt(args[i], error);
+    CheckDivisor(rhs.IsZero());
+    if (!(lhs % rhs).IsZero()) {
+      break;
+    }
+    exact = MakeInteger(lhs / rhs);
+  }
+  if (i == args.size()) {
+    return exact;
+  }
+  auto real = ToDouble(exact, error);
+  for (; i < args.size(); ++i) {
+    // Деление на точный ноль - ошибка на любой позиции
+    if (!AsFlonum(args[i])) {
+      CheckDivisor(args[i].IsFixnum() && args[i].GetFixnum() == 0);
     }
+    real /= ToDouble(args[i], error);
   }
-  return std::make_shared<Boolean>(value);
+  return MakeFlonum(real);
 }
-std::shared_ptr<Object>
-LessOrEqual::Apply(const std::shared_ptr<Scope> &scp,
-                   const std::vector<std::shared_ptr<Object>> &args) {
-  bool value = true;
 
-  if (!args.empty()) {
-    if (auto last_value = std::dynamic_pointer_cast<NumberNode>(args[0])) {
-      for (auto arg = args.begin() + 1; arg != args.end(); ++arg) {
-        auto number = std::dynamic_pointer_cast<NumberNode>(*arg);
-        if (!number) {
-          throw RuntimeError("Wrong type for LessOrEqual func value");
-        }
-        value = ((last_value->GetValue() <= number->GetValue()) && value);
-        last_value = number;
-      }
-    } else {
-      throw RuntimeError("Wrong type for LessOrEqual func value");
-    }
+Value Multiply::Apply(ArgList args) {
+  return FoldNumbers(
+      Value::Fixnum(1), args.begin(), args.end(),
+      "Wrong type for multiply func value", MulOverflow,
+      [](const BigInt &lhs, const BigInt &rhs) { return lhs * rhs; },
+      [](double lhs, double rhs) { return lhs * rhs; });
+}
+
+Value Quotient::Apply(ArgList args) {
+  return DivideIntegers(
+      args, "quotient func should have two integer arguments",
+      [](int64_t lhs, int64_t rhs) { return lhs / rhs; },
+      [](const BigInt &lhs, const BigInt &rhs) { return lhs / rhs; });
+}
+
+Value Remainder::Apply(ArgList args) {
+  return DivideIntegers(
+      args, "remainder func should have two integer arguments",
+      [](int64_t lhs, int64_t rhs) { return lhs % rhs; },
+      [](const BigInt &lhs, const BigInt &rhs) { return lhs % rhs; });
+}
+
+Value ExactToInexact::Apply(ArgList args) {
+  if (args.size() != 1) {
+    throw RuntimeError("exact->inexact func should have strictly one argument");
   }
-  return std::make_shared<Boolean>(value);
+  if (AsFlonum(args[0])) {
+    return args[0];
+  }
+  return MakeFlonum(ToDouble(args[0], "Wrong type for exact->inexact func value"));
+}
+
+//// Предикаты
+Value Equal::Apply(ArgList args) {
+  return CompareChain(args, "Wrong type for Equal func value",
+                      [](int order) { return order == 0; });
+}
+Value Greater::Apply(ArgList args) {
+  return CompareChain(args, "Wrong type for Greater func value",
+                      [](int order) { return order > 0; });
+}
+Value GreaterOrEqual::Apply(ArgList args) {
+  return CompareChain(args, "Wrong type for GreaterOrEqual func value",
+                      [](int order) { return order >= 0; });
+}
+Value Less::Apply(ArgList args) {
+  return CompareChain(args, "Wrong type for Less func value",
+                      [](int order) { return order < 0; });
+}
+Value LessOrEqual::Apply(ArgList args) {
+  return CompareChain(args, "Wrong type for LessOrEqual func value",
+                      [](int order) { return order <= 0; });
 }
 ////
 
 //// Min/Max
-std::shared_ptr<Object>
-Max::Apply(const std::shared_ptr<Scope> &scp,
-           const std::vector<std::shared_ptr<Object>> &args) {
-  if (!args.empty()) {
-    if (auto cast = std::dynamic_pointer_cast<NumberNode>(args[0])) {
-      auto max_val = cast->GetValue();
-      for (const auto &arg : args) {
-        auto number = std::dynamic_pointer_cast<NumberNode>(arg);
-        if (!number) {
-          throw RuntimeError("Wrong type for max func value");
-        }
-        max_val = std::max(max_val, number->GetValue());
-      }
-      return std::make_shared<NumberNode>(max_val);
-    } else {
-      throw RuntimeError("Wrong type for max func value");
-    }
-  } else {
+Value Max::Apply(ArgList args) {
+  if (args.empty()) {
     throw RuntimeError("Max func should have at least one argument");
   }
+  return SelectNumber(args, "Wrong type for max func value",
+                      [](int order) { return order > 0; });
 }
-std::shared_ptr<Object>
-Min::Apply(const std::shared_ptr<Scope> &scp,
-           const std::vector<std::shared_ptr<Object>> &args) {
-  if (!args.empty()) {
-    if (auto cast = std::dynamic_pointer_cast<NumberNode>(args[0])) {
-      auto max_val = cast->GetValue();
-      for (const auto &arg : args) {
-        auto number = std::dynamic_pointer_cast<NumberNode>(arg);
-        if (!number) {
-          throw RuntimeError("Wrong type for min func value");
-        }
-        max_val = std::min(max_val, number->GetValue());
-      }
-      return std::make_shared<NumberNode>(max_val);
-    } else {
-      throw RuntimeError("Wrong type for max func value");
-    }
-  } else {
+Value Min::Apply(ArgList args) {
+  if (args.empty()) {
     throw RuntimeError("Min func should have at least one argument");
   }
+  return SelectNumber(args, "Wrong type for min func value",
+                      [](int order) { return order < 0; });
 }
 ////
-std::shared_ptr<Object>
-Abs::Apply(const std::shared_ptr<Scope> &scp,
-           const std::vector<std::shared_ptr<Object>> &args) {
-  if (args.size() == 1) {
-    if (auto number = std::dynamic_pointer_cast<NumberNode>(args[0])) {
-      return std::make_shared<NumberNode>(std::abs(number->GetValue()));
-    } else {
-      throw RuntimeError("Wrong type for abs func value");
-    }
-  } else {
+Value Abs::Apply(ArgList args) {
+  if (args.size() != 1) {
     throw RuntimeError("Abs func should have strictly one argument");
   }
+  if (args[0].IsFixnum()) {
+    return MakeInteger(std::abs(args[0].GetFixnum()));
+  }
+  if (auto flonum = AsFlonum(args[0])) {
+    return MakeFlonum(std::fabs(flonum->GetValue()));
+  }
+  return MakeInteger(ToBigInt(args[0], "Wrong type for abs func value").Abs());
 }
 
-std::shared_ptr<Object>
-NumberCheck::Apply(const std::shared_ptr<Scope> &scp,
-                   const std::vector<std::shared_ptr<Object>> &args) {
-  if (args.size() == 1) {
-    if (auto number = std::dynamic_pointer_cast<NumberNode>(args[0])) {
-      return std::make_shared<Boolean>(true);
-    } else {
-      return std::make_shared<Boolean>(false);
-    }
-  } else {
+Value NumberCheck::Apply(ArgList args) {
+  if (args.size() != 1) {
     throw RuntimeError("Too many arguments in Number check");
   }
+  return Value::Bool(IsNumber(args[0]));
 }
 
-std::shared_ptr<Object>
-PairCheck::Apply(const std::shared_ptr<Scope> &scp,
-                 const std::vector<std::shared_ptr<Object>> &args) {
-  if (auto cast = std::dynamic_pointer_cast<CellNode>(args[0])) {
-    return std::make_shared<Boolean>(true);
-  } else {
-    return std::make_shared<Boolean>(false);
+Value PairCheck::Apply(ArgList args) {
+  if (args.size() != 1) {
+    throw RuntimeError("pair? func should have strictly one argument");
   }
+  return Value::Bool(IsCell(args[0]));
 }
 
-std::shared_ptr<Object>
-NullCheck::Apply(const std::shared_ptr<Scope> &scp,
-                 const std::vector<std::shared_ptr<Object>> &args) {
-  if (auto cast = std::dynamic_pointer_cast<CellNode>(args[0])) {
-    return std::make_shared<Boolean>(false);
-  } else {
-    return std::make_shared<Boolean>(true);
+Value NullCheck::Apply(ArgList args) {
+  if (args.size() != 1) {
+    throw RuntimeError("null? func should have strictly one argument");
   }
+  return Value::Bool(!IsCell(args[0]));
 }
-std::shared_ptr<Object>
-ListCheck::Apply(const std::shared_ptr<Scope> &scp,
-                 const std::vector<std::shared_ptr<Object>> &args) {
-  auto cur_head = std::dynamic_pointer_cast<CellNode>(args[0]);
+
+Value ListCheck::Apply(ArgList args) {
+  if (args.size() != 1) {
+    throw RuntimeError("list? func should have strictly one argument");
+  }
+  auto cur_head = AsCell(args[0]);
   while (cur_head && cur_head->GetSecond()) {
-    if (auto cast =
-            std::dynamic_pointer_cast<CellNode>(cur_head->GetSecond())) {
-      cur_head = cast;
-    } else {
-      return std::make_shared<Boolean>(false);
+    cur_head = AsCell(cur_head->GetSecond());
+    if (!cur_head) {
+      return Value::Bool(false);
     }
   }
-  return std::make_shared<Boolean>(true);
+  return Value::Bool(true);
 }
 
-std::shared_ptr<Object>
-BooleanCheck::Apply(const std::shared_ptr<Scope> &scp,
-                    const std::vector<std::shared_ptr<Object>> &args) {
-  if (auto cast = std::dynamic_pointer_cast<Boolean>(args[0])) {
-    return std::make_shared<Boolean>(true);
+Value BooleanCheck::Apply(ArgList args) {
+  if (args.size() != 1) {
+    throw RuntimeError("boolean? func should have strictly one argument");
   }
-  return std::make_shared<Boolean>(false);
+  return Value::Bool(args[0].IsBool());
 }
 
-std::shared_ptr<Object>
-SymbolCheck::Apply(const std::shared_ptr<Scope> &scp,
-                   const std::vector<std::shared_ptr<Object>> &args) {
-  if (auto cast = std::dynamic_pointer_cast<SymbolNode>(args[0])) {
-    return std::make_shared<Boolean>(true);
+Value SymbolCheck::Apply(ArgList args) {
+  if (args.size() != 1) {
+    throw RuntimeError("symbol? func should have strictly one argument");
   }
-  return std::make_shared<Boolean>(false);
+  return Value::Bool(IsSymbol(args[0]));
 }
 
-std::shared_ptr<Object>
-Not::Apply(const std::shared_ptr<Scope> &scp,
-           const std::vector<std::shared_ptr<Object>> &args) {
-  if (args.size() == 1) {
-    if (auto cast = std::dynamic_pointer_cast<Boolean>(args[0])) {
-      return std::make_shared<Boolean>(!cast->GetVal());
-    }
-    return std::make_shared<Boolean>(false);
-  } else {
-    throw RuntimeError("too many arguments for not func");
+Value Eq::Apply(ArgList args) {
+  if (args.size() != 2) {
+    throw RuntimeError("eq? func should have strictly two arguments");
   }
+  return Value::Bool(args[0] == args[1]);
 }
-std::shared_ptr<Object>
-And::Apply(const std::shared_ptr<Scope> &scp,
-           const std::vector<std::shared_ptr<Object>> &args) {
-  if (!args.empty()) {
-    for (auto &arg : args) {
-      auto new_arg = arg->Evaluate(scp);
-      auto cast_bool = std::dynamic_pointer_cast<Boolean>(new_arg);
-      auto cast_cell = std::dynamic_pointer_cast<CellNode>(new_arg);
-      if (cast_bool && !cast_bool->GetVal()) {
-        return cast_bool;
-      }
-      if (cast_cell) {
-        return cast_cell;
-      }
-    }
+
+Value StructEqual::Apply(ArgList args) {
+  if (args.size() != 2) {
+    throw RuntimeError("equal? func should have strictly two arguments");
   }
-  return std::make_shared<Boolean>(true);
+  return Value::Bool(IsEqual(args[0], args[1]));
 }
 
-std::shared_ptr<Object>
-Or::Apply(const std::shared_ptr<Scope> &scp,
-          const std::vector<std::shared_ptr<Object>> &args) {
-  if (!args.empty()) {
-    bool flg = true;
-    for (auto &arg : args) {
-      auto new_arg = arg->Evaluate(scp);
-      auto cast_bool = std::dynamic_pointer_cast<Boolean>(new_arg);
-      auto cast_cell = std::dynamic_pointer_cast<CellNode>(new_arg);
-      if (cast_bool && cast_bool->GetVal()) {
-        return cast_bool;
-      } else if (!cast_bool) {
-        return new_arg;
-      }
-    }
+Value Not::Apply(ArgList args) {
+  if (args.size() != 1) {
+    throw RuntimeError("too many arguments for not func");
   }
-  return std::make_shared<Boolean>(false);
+  return Value::Bool(args[0] == Value::Bool(false));
 }
-
-std::shared_ptr<Object>
-Cons::Apply(const std::shared_ptr<Scope> &scp,
-            const std::vector<std::shared_ptr<Object>> &args) {
-  auto cell_node = std::make_shared<CellNode>();
-  cell_node->SetFirst(args[0]);
-  cell_node->SetSecond(args[1]);
-  return cell_node;
+Value Cons::Apply(ArgList args) {
+  if (args.size() != 2) {
+    throw RuntimeError("cons func should have strictly two arguments");
+  }
+  return New<CellNode>(args[0], args[1]);
 }
 //// Методы Syntax
-void Syntax::PrintTo(std::ostream *out) { *out << "<syntax>"; }
-
-std::shared_ptr<Object> Syntax::Evaluate(std::shared_ptr<Scope> scp) {
-  throw RuntimeError("can't eval syntax");
-}
+void Syntax::PrintTo(std::string *out) { *out += "<syntax>"; }
+void Quote::PrintTo(std::string *out) { Syntax::PrintTo(out); }
+void Define::PrintTo(std::string *out) {}
+void Set::PrintTo(std::string *out) {}
+////
 
-std::shared_ptr<Object>
-Quote::Apply(const std::shared_ptr<Scope> &scp,
-             const std::vector<std::shared_ptr<Object>> &args) {
+//// Функции над списками
+Value Car::Apply(ArgList args) {
   if (args.size() != 1) {
-    throw SyntaxError("Wrong size for list");
+    throw RuntimeError("car func should have strictly one argument");
   }
-  return args[0];
+  if (auto cell = AsCell(args[0])) {
+    return cell->GetFirst();
+  }
+  throw RuntimeError("Wrong type for car func value");
 }
-
-void Quote::PrintTo(std::ostream *out) { Syntax::PrintTo(out); }
-std::shared_ptr<Object>
-If::Apply(const std::shared_ptr<Scope> &scp,
-          const std::vector<std::shared_ptr<Object>> &args) {
-
-  if (args.size() >= 2 && args.size() <= 3) {
-    auto condition = args[0];
-    auto true_branch = args[1];
-    std::shared_ptr<Object> false_branch = nullptr;
-    if (args.size() == 3) {
-      false_branch = args[2];
-    }
-    auto result = std::dynamic_pointer_cast<Boolean>(condition->Evaluate(scp));
-    if (result->GetVal()) {
-      return true_branch->Evaluate(scp);
-    } else if (false_branch) {
-      return false_branch->Evaluate(scp);
-    } else {
-      return false_branch;
-    }
-  } else {
-    throw SyntaxError("Incorrect number of arguments");
+Value Cdr::Apply(ArgList args) {
+  if (args.size() != 1) {
+    throw RuntimeError("cdr func should have strictly one argument");
+  }
+  if (auto cell = AsCell(args[0])) {
+    return cell->GetSecond();
   }
+  throw RuntimeError("Wrong type for cdr func value");
 }
-std::shared_ptr<Object>
-Car::Apply(const std::shared_ptr<Scope> &scp,
-           const std::vector<std::shared_ptr<Object>> &args) {
-  if (auto cast = std::dynamic_pointer_cast<CellNode>(args[0])) {
-    return std::dynamic_pointer_cast<CellNode>(args[0]->Evaluate(scp))
-        ->GetFirst();
-  } else if (auto cast = std::dynamic_pointer_cast<SymbolNode>(args[0])) {
-    return args[0]->Evaluate(scp);
+Value SetCar::Apply(ArgList args) {
+  if (args.size() != 2) {
+    throw RuntimeError("set-car! func should have strictly two arguments");
   }
+  if (auto cell = AsCell(args[0])) {
+    cell->SetFirst(args[1]);
+    return Value(this);
+  }
+  throw RuntimeError("Wrong type for set-car! func value");
 }
-std::shared_ptr<Object>
-Cdr::Apply(const std::shared_ptr<Scope> &scp,
-           const std::vector<std::shared_ptr<Object>> &args) {
-  if (auto cast = std::dynamic_pointer_cast<CellNode>(args[0])) {
-    return std::dynamic_pointer_cast<CellNode>(args[0]->Evaluate(scp))
-        ->GetSecond();
-  } else if (auto cast = std::dynamic_pointer_cast<SymbolNode>(args[0])) {
-    return args[0]->Evaluate(scp);
+void SetCar::PrintTo(std::string *out) {}
+Value SetCdr::Apply(ArgList args) {
+  if (args.size() != 2) {
+    throw RuntimeError("set-cdr! func should have strictly two arguments");
+  }
+  if (auto cell = AsCell(args[0])) {
+    cell->SetSecond(args[1]);
+    return Value(this);
   }
+  throw RuntimeError("Wrong type for set-cdr! func value");
 }
-std::shared_ptr<Object>
-Define::Apply(const std::shared_ptr<Scope> &scp,
-              const std::vector<std::shared_ptr<Object>> &args) {
-  if (args.size() == 2) {
-    if (auto arg_cast = std::dynamic_pointer_cast<SymbolNode>(args[0])) {
-      scp->scope_[std::dynamic_pointer_cast<SymbolNode>(args[0])->GetName()] =
-          args[1]->Evaluate(scp);
-      return shared_from_this();
-    } else if (auto arg_cast = std::dynamic_pointer_cast<CellNode>(args[0])) {
-      std::shared_ptr<LambdaFunc> new_func = std::make_shared<LambdaFunc>();
-      for (size_t i = 1; i < args.size(); ++i) {
-        new_func->lambda_func.push_back(args[i]);
-      }
-      new_func->local_scope_ = std::make_shared<Scope>(*scp);
-      new_func->params_ = ToVector(arg_cast->GetSecond());
+void SetCdr::PrintTo(std::string *out) {}
 
-      scp->scope_[std::dynamic_pointer_cast<SymbolNode>(arg_cast->GetFirst())
-                      ->GetName()] = new_func;
-      return shared_from_this();
-    }
-  } else {
-    throw SyntaxError("not enough arguments");
-  }
-}
-void Define::PrintTo(std::ostream *out) {}
-std::shared_ptr<Object>
-SetCar::Apply(const std::shared_ptr<Scope> &scp,
-              const std::vector<std::shared_ptr<Object>> &args) {
-  scp->scope_[std::dynamic_pointer_cast<SymbolNode>(args[0])->GetName()] =
-      args[1]->Evaluate(scp);
-  return shared_from_this();
-}
-void SetCar::PrintTo(std::ostream *out) {}
-std::shared_ptr<Object>
-SetCdr::Apply(const std::shared_ptr<Scope> &scp,
-              const std::vector<std::shared_ptr<Object>> &args) {
-  scp->scope_[std::dynamic_pointer_cast<SymbolNode>(args[0])->GetName()] =
-      args[1]->Evaluate(scp);
-  return shared_from_this();
-}
-void SetCdr::PrintTo(std::ostream *out) {}
-
-std::shared_ptr<Object>
-Set::Apply(const std::shared_ptr<Scope> &scp,
-           const std::vector<std::shared_ptr<Object>> &args) {
-  if (args.size() == 2) {
-    if (scp->scope_.find(
-            std::dynamic_pointer_cast<SymbolNode>(args[0])->GetName()) !=
-        scp->scope_.end()) {
-      scp->scope_[std::dynamic_pointer_cast<SymbolNode>(args[0])->GetName()] =
-          args[1]->Evaluate(scp);
-      return shared_from_this();
-    } else {
-      throw NameError("Can't find variable");
-    }
-  } else {
-    throw SyntaxError("not enough arguments");
+Value ListCmd::Apply(ArgList args) {
+  Value list;
+  for (auto iter = args.end(); iter != args.begin();) {
+    --iter;
+    list = New<CellNode>(*iter, std::move(list));
   }
+  return list;
 }
-void Set::PrintTo(std::ostream *out) {}
-std::shared_ptr<Object>
-ListCmd::Apply(const std::shared_ptr<Scope> &scp,
-               const std::vector<std::shared_ptr<Object>> &args) {
-  if (!args.empty()) {
-    auto root_node = std::make_shared<CellNode>();
-    auto head = root_node;
-    for (auto iter = args.begin(); iter != args.end(); ++iter) {
-      head->SetFirst(*iter);
-      if (iter != (args.end() - 1)) {
-        head->SetSecond(std::make_shared<CellNode>());
-        head = std::dynamic_pointer_cast<CellNode>(head->GetSecond());
-      }
-    }
-    return root_node;
-  } else {
-    return nullptr;
+Value ListTail::Apply(ArgList args) {
+  if (args.size() != 2 || !IsCell(args[0]) || !IsNumber(args[1])) {
+    throw RuntimeError("Wrong arguments for list index func");
   }
-}
-std::shared_ptr<Object>
-ListTail::Apply(const std::shared_ptr<Scope> &scp,
-                const std::vector<std::shared_ptr<Object>> &args) {
-  auto iter_num = std::dynamic_pointer_cast<NumberNode>(args[1])->GetValue();
-  auto cur_head = args[0]->Evaluate(scp);
-  auto next_head = std::dynamic_pointer_cast<CellNode>(cur_head)->GetSecond();
+  if (!args[1].IsFixnum()) {
+    throw RuntimeError("too big index");
+  }
+  auto iter_num = args[1].GetFixnum();
+  Value cur_head = args[0];
+  Value next_head = AsCell(cur_head)->GetSecond();
   while (iter_num > 0 && next_head) {
     cur_head = next_head;
-    next_head = std::dynamic_pointer_cast<CellNode>(cur_head)->GetSecond();
+    next_head = AsCell(cur_head)->GetSecond();
     --iter_num;
   }
   if (iter_num == 0) {
@@ -587,117 +596,804 @@ ListTail::Apply(const std::shared_ptr<Scope> &scp,
     throw RuntimeError("too big index");
   }
 }
-std::shared_ptr<Object>
-ListRef::Apply(const std::shared_ptr<Scope> &scp,
-               const std::vector<std::shared_ptr<Object>> &args) {
+Value ListRef::Apply(ArgList args) {
 
-  auto iter_num = std::dynamic_pointer_cast<NumberNode>(args[1])->GetValue();
-  auto cur_head = args[0]->Evaluate(scp);
-  auto next_head = std::dynamic_pointer_cast<CellNode>(cur_head)->GetSecond();
+  if (args.size() != 2 || !IsCell(args[0]) || !IsNumber(args[1])) {
+    throw RuntimeError("Wrong arguments for list index func");
+  }
+  if (!args[1].IsFixnum()) {
+    throw RuntimeError("too big index");
+  }
+  auto iter_num = args[1].GetFixnum();
+  Value cur_head = args[0];
+  Value next_head = AsCell(cur_head)->GetSecond();
   while (iter_num > 0 && next_head) {
     cur_head = next_head;
-    next_head = std::dynamic_pointer_cast<CellNode>(cur_head)->GetSecond();
+    next_head = AsCell(cur_head)->GetSecond();
     --iter_num;
   }
   if (iter_num == 0) {
-    return std::dynamic_pointer_cast<CellNode>(cur_head)->GetFirst();
+    return AsCell(cur_head)->GetFirst();
   } else {
     throw RuntimeError("too big index");
   }
 }
 
-std::shared_ptr<Object>
-Lambda::Apply(const std::shared_ptr<Scope> &scp,
-              const std::vector<std::shared_ptr<Object>> &args) {
-  if (args.size() >= 2) {
-    std::shared_ptr<LambdaFunc> new_func = std::make_shared<LambdaFunc>();
-    for (size_t i = 1; i < args.size(); ++i) {
-      new_func->lambda_func.push_back(args[i]);
-    }
-    new_func->local_scope_ = std::make_shared<Scope>(*scp);
-    new_func->params_ = ToVector(args[0]);
-    return new_func;
-  } else {
-    throw SyntaxError("Invalid number of arguments in lambda function");
+////
+
+//// Векторы
+namespace {
+VectorNode *CheckVector(const Value &obj, const char *error) {
+  if (auto vector = AsVector(obj)) {
+    return vector;
+  }
+  throw RuntimeError(error);
+}
+
+size_t CheckIndex(size_t size, const Value &index) {
+  if (!index.IsFixnum() || index.GetFixnum() < 0 ||
+      static_cast<uint64_t>(index.GetFixnum()) >= size) {
+    throw RuntimeError("Vector index out of range");
   }
+  return index.GetFixnum();
 }
+} // namespace
 
-std::shared_ptr<Object>
-LambdaFunc::Apply(const std::shared_ptr<Scope> &scp,
-                  const std::vector<std::shared_ptr<Object>> &args) {
-  for (size_t i = 0; i < params_.size(); ++i) {
-    local_scope_
-        ->scope_[std::dynamic_pointer_cast<SymbolNode>(params_[i])->GetName()] =
-        args[i]->Evaluate(scp);
+Value MakeVector::Apply(ArgList args) {
+  if (args.empty() || args.size() > 2) {
+    throw RuntimeError("make-vector func should have one or two arguments");
+  }
+  if (!args[0].IsFixnum() || args[0].GetFixnum() < 0) {
+    throw RuntimeError("Wrong size for make-vector func");
+  }
+  auto fill = args.size() == 2 ? args[1] : Value::Fixnum(0);
+  return New<VectorNode>(std::vector<Value>(args[0].GetFixnum(), fill));
+}
+Value VectorCmd::Apply(ArgList args) {
+  return New<VectorNode>(std::vector<Value>(args.begin(), args.end()));
+}
+Value VectorCheck::Apply(ArgList args) {
+  if (args.size() != 1) {
+    throw RuntimeError("vector? func should have strictly one argument");
   }
-  auto original_scope = std::make_shared<Scope>(*local_scope_);
-  local_scope_->scope_.insert(scp->scope_.begin(), scp->scope_.end());
-  std::shared_ptr<Object> last_val = nullptr;
-  for (auto &func : lambda_func) {
-    last_val = func->Evaluate(local_scope_);
+  return Value::Bool(AsVector(args[0]));
+}
+Value VectorLength::Apply(ArgList args) {
+  if (args.size() != 1) {
+    throw RuntimeError("vector-length func should have strictly one argument");
   }
+  auto vector = CheckVector(args[0], "Wrong type for vector-length func value");
+  return Value::Fixnum(vector->Size());
+}
+Value VectorRef::Apply(ArgList args) {
+  if (args.size() != 2) {
+    throw RuntimeError("vector-ref func should have strictly two arguments");
+  }
+  auto vector = CheckVector(args[0], "Wrong type for vector-ref func value");
+  return vector->Get(CheckIndex(vector->Size(), args[1]));
+}
+Value VectorSet::Apply(ArgList args) {
+  if (args.size() != 3) {
+    throw RuntimeError("vector-set! func should have strictly three arguments");
+  }
+  auto vector = CheckVector(args[0], "Wrong type for vector-set! func value");
+  vector->Set(CheckIndex(vector->Size(), args[1]), args[2]);
+  return Value(this);
+}
+void VectorSet::PrintTo(std::string *out) {}
+Value VectorToList::Apply(ArgList args) {
+  if (args.size() != 1) {
+    throw RuntimeError("vector->list func should have strictly one argument");
+  }
+  auto vector = CheckVector(args[0], "Wrong type for vector->list func value");
+  Value list;
+  for (auto index = vector->Size(); index > 0; --index) {
+    list = New<CellNode>(vector->Get(index - 1), std::move(list));
+  }
+  return list;
+}
+Value ListToVector::Apply(ArgList args) {
+  if (args.size() != 1 || (args[0] && !IsCell(args[0]))) {
+    throw RuntimeError("Wrong arguments for list->vector func");
+  }
+  return New<VectorNode>(ToVector(args[0]));
+}
+
+VectorNode::VectorNode(std::vector<Value> elements)
+    : Object(ObjectType::kVector), elements_(std::move(elements)) {}
+void VectorNode::PrintTo(std::string *out) { ::PrintTo(Value(this), out); }
+////
+
+//// Хеш-таблицы
+namespace {
+HashTableNode *CheckHashTable(ArgList args, size_t min_size, size_t max_size,
+                              const char *error) {
+  if (args.size() < min_size || args.size() > max_size) {
+    throw RuntimeError(error);
+  }
+  if (auto table = AsHashTable(args[0])) {
+    return table;
+  }
+  throw RuntimeError(error);
+}
+
+// Список из занятых слотов таблицы; element строит элемент по индексу слота
+template <class Element>
+Value CollectEntries(HashTableNode *table, Element element) {
+  Value list;
+  for (size_t index = table->Capacity(); index > 0; --index) {
+    if (table->Occupied(index - 1)) {
+      list = New<CellNode>(element(index - 1), std::move(list));
+    }
+  }
+  return list;
+}
+} // namespace
 
-  std::vector<std::string> keys_to_remove;
-  for (auto &el : local_scope_->scope_) {
-    if (original_scope->scope_.find(el.first) == local_scope_->scope_.end()) {
-      keys_to_remove.push_back(el.first);
+Value MakeHashTable::Apply(ArgList args) {
+  if (!args.empty()) {
+    throw RuntimeError("make-hash-table func should have no arguments");
+  }
+  return New<HashTableNode>();
+}
+Value HashTableCheck::Apply(ArgList args) {
+  if (args.size() != 1) {
+    throw RuntimeError("hash-table? func should have strictly one argument");
+  }
+  return Value::Bool(AsHashTable(args[0]));
+}
+Value HashTableRef::Apply(ArgList args) {
+  auto table =
+      CheckHashTable(args, 2, 3, "Wrong arguments for hash-table-ref func");
+  if (auto value = table->Find(args[1])) {
+    return *value;
+  }
+  if (args.size() == 3) {
+    if (auto thunk = As<Function>(args[2].GetObject())) {
+      return thunk->Apply(ArgList(nullptr, 0));
+    }
+    throw RuntimeError("Wrong arguments for hash-table-ref func");
+  }
+  throw RuntimeError("No such key in hash table");
+}
+Value HashTableRefDefault::Apply(ArgList args) {
+  auto table = CheckHashTable(args, 3, 3,
+                              "Wrong arguments for hash-table-ref/default func");
+  auto value = table->Find(args[1]);
+  return value ? *value : args[2];
+}
+Value HashTableSet::Apply(ArgList args) {
+  auto table =
+      CheckHashTable(args, 3, 3, "Wrong arguments for hash-table-set! func");
+  table->Set(args[1], args[2]);
+  return Value(this);
+}
+void HashTableSet::PrintTo(std::string *out) {}
+Value HashTableDelete::Apply(ArgList args) {
+  auto table =
+      CheckHashTable(args, 2, 2, "Wrong arguments for hash-table-delete! func");
+  table->Erase(args[1]);
+  return Value(this);
+}
+void HashTableDelete::PrintTo(std::string *out) {}
+Value HashTableContains::Apply(ArgList args) {
+  auto table = CheckHashTable(args, 2, 2,
+                              "Wrong arguments for hash-table-contains? func");
+  return Value::Bool(table->Find(args[1]));
+}
+Value HashTableCount::Apply(ArgList args) {
+  auto table =
+      CheckHashTable(args, 1, 1, "Wrong arguments for hash-table-count func");
+  return Value::Fixnum(table->Count());
+}
+Value HashTableKeys::Apply(ArgList args) {
+  auto table =
+      CheckHashTable(args, 1, 1, "Wrong arguments for hash-table-keys func");
+  return CollectEntries(table,
+                        [table](size_t index) { return table->KeyAt(index); });
+}
+Value HashTableValues::Apply(ArgList args) {
+  auto table =
+      CheckHashTable(args, 1, 1, "Wrong arguments for hash-table-values func");
+  return CollectEntries(
+      table, [table](size_t index) { return table->ValueAt(index); });
+}
+Value HashTableToAlist::Apply(ArgList args) {
+  auto table =
+      CheckHashTable(args, 1, 1, "Wrong arguments for hash-table->alist func");
+  return CollectEntries(table, [table](size_t index) {
+    return Value(New<CellNode>(table->KeyAt(index), table->ValueAt(index)));
+  });
+}
+// proc может менять таблицу, поэтому индекс сверяется с ёмкостью на каждом
+// шаге, а ключ и значение копируются до вызова
+Value HashTableWalk::Apply(ArgList args) {
+  auto table =
+      CheckHashTable(args, 2, 2, "Wrong arguments for hash-table-walk func");
+  auto proc = As<Function>(args[1].GetObject());
+  if (!proc) {
+    throw RuntimeError("Wrong arguments for hash-table-walk func");
+  }
+  for (size_t index = 0; index < table->Capacity(); ++index) {
+    if (table->Occupied(index)) {
+      Value entry[] = {table->KeyAt(index), table->ValueAt(index)};
+      proc->Apply(ArgList(entry, 2));
     }
   }
-  for (auto &key : keys_to_remove) {
-    local_scope_->scope_.erase(key);
+  return Value(this);
+}
+void HashTableWalk::PrintTo(std::string *out) {}
+////
+
+//// Строки
+namespace {
+StringNode *CheckString(const Value &obj, const char *error) {
+  if (auto string = AsString(obj)) {
+    return string;
   }
+  throw RuntimeError(error);
+}
+
+StringPortNode *CheckPort(const Value &obj, const char *error) {
+  if (auto port = As<StringPortNode>(obj.GetObject())) {
+    return port;
+  }
+  throw RuntimeError(error);
+}
 
-  //    local_scope_ = original_scope;
-  return last_val;
+// Позиция в строке для substring: fixnum в [0, size]
+size_t CheckPosition(const Value &position, size_t size) {
+  if (!position.IsFixnum() || position.GetFixnum() < 0 ||
+      static_cast<uint64_t>(position.GetFixnum()) > size) {
+    throw RuntimeError("Substring index out of range");
+  }
+  return position.GetFixnum();
+}
+} // namespace
+
+StringNode::StringNode(std::string value)
+    : Object(ObjectType::kString), value_(std::move(value)) {}
+void StringNode::PrintTo(std::string *out) {
+  *out += '"';
+  for (auto c : value_) {
+    if (c == '"' || c == '\\') {
+      *out += '\\';
+      *out += c;
+    } else if (c == '\n') {
+      *out += "\\n";
+    } else if (c == '\t') {
+      *out += "\\t";
+    } else if (c == '\r') {
+      *out += "\\r";
+    } else {
+      *out += c;
+    }
+  }
+  *out += '"';
 }
-// LambdaFunc::~LambdaFunc() {
-//    if (local_scope_) {
-//        local_scope_->scope_.clear();
-//    }
-//    params_.clear();
-//    lambda_func.clear();
-//}
 
+Value StringCheck::Apply(ArgList args) {
+  if (args.size() != 1) {
+    throw RuntimeError("string? func should have strictly one argument");
+  }
+  return Value::Bool(AsString(args[0]));
+}
+Value StringLength::Apply(ArgList args) {
+  if (args.size() != 1) {
+    throw RuntimeError("string-length func should have strictly one argument");
+  }
+  auto string = CheckString(args[0], "Wrong type for string-length func value");
+  return Value::Fixnum(string->GetValue().size());
+}
+// Итоговая длина считается заранее: одно выделение на результат
+Value StringAppend::Apply(ArgList args) {
+  size_t size = 0;
+  for (auto &arg : args) {
+    size += CheckString(arg, "Wrong type for string-append func value")
+                ->GetValue()
+                .size();
+  }
+  std::string result;
+  result.reserve(size);
+  for (auto &arg : args) {
+    result += AsString(arg)->GetValue();
+  }
+  return New<StringNode>(std::move(result));
+}
+Value Substring::Apply(ArgList args) {
+  if (args.size() < 2 || args.size() > 3) {
+    throw RuntimeError("substring func should have two or three arguments");
+  }
+  auto &string = CheckString(args[0], "Wrong type for substring func value")
+                     ->GetValue();
+  auto start = CheckPosition(args[1], string.size());
+  auto end =
+      args.size() == 3 ? CheckPosition(args[2], string.size()) : string.size();
+  if (start > end) {
+    throw RuntimeError("Substring index out of range");
+  }
+  return New<StringNode>(string.substr(start, end - start));
+}
+Value StringEqual::Apply(ArgList args) {
+  for (auto &arg : args) {
+    CheckString(arg, "Wrong type for string=? func value");
+  }
+  for (size_t i = 1; i < args.size(); ++i) {
+    if (AsString(args[i - 1])->GetValue() != AsString(args[i])->GetValue()) {
+      return Value::Bool(false);
+    }
+  }
+  return Value::Bool(true);
+}
+Value StringToSymbol::Apply(ArgList args) {
+  if (args.size() != 1) {
+    throw RuntimeError("string->symbol func should have strictly one argument");
+  }
+  return Intern(
+      CheckString(args[0], "Wrong type for string->symbol func value")
+          ->GetValue());
+}
+Value SymbolToString::Apply(ArgList args) {
+  if (args.size() != 1 || !IsSymbol(args[0])) {
+    throw RuntimeError("Wrong arguments for symbol->string func");
+  }
+  return New<StringNode>(AsSymbol(args[0])->GetName());
+}
+Value NumberToString::Apply(ArgList args) {
+  if (args.size() != 1) {
+    throw RuntimeError("number->string func should have strictly one argument");
+  }
+  CheckNumber(args[0], "Wrong type for number->string func value");
+  return New<StringNode>(Print(args[0]));
+}
 ////
-//// Boolean
-void Boolean::PrintTo(std::ostream *out) { *out << (val_ ? "#t" : "#f"); }
-bool Boolean::GetVal() { return val_; }
-Boolean::Boolean(bool val) : val_(val) {}
-
-std::vector<std::shared_ptr<Object>>
-ToVector(const std::shared_ptr<Object> &head) {
-  std::vector<std::shared_ptr<Object>> elements;
-  if (head) {
-    elements.push_back(std::dynamic_pointer_cast<CellNode>(head)->GetFirst());
-    auto cur_head = std::dynamic_pointer_cast<CellNode>(head)->GetSecond();
-    while (cur_head && (!std::dynamic_pointer_cast<Function>(cur_head)) &&
-           (!std::dynamic_pointer_cast<Syntax>(cur_head))) {
-      elements.push_back(
-          std::dynamic_pointer_cast<CellNode>(cur_head)->GetFirst());
-      cur_head = std::dynamic_pointer_cast<CellNode>(cur_head)->GetSecond();
+
+//// Строковые порты
+StringPortNode::StringPortNode() : Object(ObjectType::kStringPort) {}
+void StringPortNode::PrintTo(std::string *out) { *out += "#<string-port>"; }
+
+Value OpenOutputString::Apply(ArgList args) {
+  if (!args.empty()) {
+    throw RuntimeError("open-output-string func should have no arguments");
+  }
+  return New<StringPortNode>();
+}
+Value GetOutputString::Apply(ArgList args) {
+  if (args.size() != 1) {
+    throw RuntimeError(
+        "get-output-string func should have strictly one argument");
+  }
+  return New<StringNode>(
+      CheckPort(args[0], "Wrong type for get-output-string func value")
+          ->Buffer());
+}
+Value WriteString::Apply(ArgList args) {
+  if (args.size() != 2) {
+    throw RuntimeError("write-string func should have strictly two arguments");
+  }
+  auto &string = CheckString(args[0], "Wrong type for write-string func value")
+                     ->GetValue();
+  CheckPort(args[1], "Wrong type for write-string func port")
+      ->Buffer()
+      .append(string);
+  return Value(this);
+}
+void WriteString::PrintTo(std::string *out) {}
+Value Display::Apply(ArgList args) {
+  if (args.size() != 2) {
+    throw RuntimeError("display func should have strictly two arguments");
+  }
+  auto port = CheckPort(args[1], "Wrong type for display func port");
+  ::PrintTo(args[0], &port->Buffer(), PrintMode::kDisplay);
+  return Value(this);
+}
+void Display::PrintTo(std::string *out) {}
+Value Write::Apply(ArgList args) {
+  if (args.size() != 2) {
+    throw RuntimeError("write func should have strictly two arguments");
+  }
+  auto port = CheckPort(args[1], "Wrong type for write func port");
+  ::PrintTo(args[0], &port->Buffer());
+  return Value(this);
+}
+void Write::PrintTo(std::string *out) {}
+Value Newline::Apply(ArgList args) {
+  if (args.size() != 1) {
+    throw RuntimeError("newline func should have strictly one argument");
+  }
+  CheckPort(args[0], "Wrong type for newline func port")->Buffer() += '\n';
+  return Value(this);
+}
+void Newline::PrintTo(std::string *out) {}
+////
+
+std::vector<Value> ToVector(const Value &head) {
+  std::vector<Value> elements;
+  for (auto cell = AsCell(head); cell; cell = AsCell(cell->GetSecond())) {
+    elements.push_back(cell->GetFirst());
+  }
+  return elements;
+}
+
+void Object::PrintTo(std::string *out) { throw RuntimeError("WTF?"); }
+void NumberNode::PrintTo(std::string *out) { *out += number_.ToString(); }
+const BigInt &NumberNode::GetValue() { return number_; }
+NumberNode::NumberNode(BigInt num)
+    : Object(ObjectType::kNumber), number_(std::move(num)) {}
+
+namespace {
+// Кратчайшая запись, которая читается обратно в то же число: обычная для
+// умеренных порядков, экспоненциальная для остальных. У целых значений
+// остаётся точка, чтобы не спутать их с точными
+void PrintDouble(double value, std::string *out) {
+  if (std::isnan(value)) {
+    *out += "+nan.0";
+    return;
+  }
+  if (std::isinf(value)) {
+    *out += (value > 0 ? "+inf.0" : "-inf.0");
+    return;
+  }
+  char buffer[64];
+  auto magnitude = std::fabs(value);
+  auto format = magnitude == 0 || (magnitude >= 1e-7 && magnitude < 1e21)
+                    ? std::chars_format::fixed
+                    : std::chars_format::scientific;
+  auto end = std::to_chars(buffer, buffer + sizeof(buffer), value, format).ptr;
+  std::string_view text(buffer, end - buffer);
+  *out += text;
+  if (text.find_first_of(".e") == std::string_view::npos) {
+    *out += ".0";
+  }
+}
+} // namespace
+
+void FlonumNode::PrintTo(std::string *out) { PrintDouble(value_, out); }
+double FlonumNode::GetValue() { return value_; }
+FlonumNode::FlonumNode(double value)
+    : Object(ObjectType::kFlonum), value_(value) {}
+
+//// Статистика выполнения
+namespace {
+Value StatsEntry(const char *name, uint64_t value) {
+  return New<CellNode>(Intern(name), Value::Fixnum(static_cast<int64_t>(value)));
+}
+} // namespace
+
+Value RuntimeStatsCmd::Apply(ArgList args) {
+  if (!args.empty()) {
+    throw RuntimeError("runtime-stats func should have no arguments");
+  }
+  auto stats = RuntimeStats::Current();
+  Value allocated;
+  for (size_t type = kObjectTypeCount; type > 0; --type) {
+    // Символы постоянны и создаются не в куче потока
+    if (static_cast<ObjectType>(type - 1) == ObjectType::kSymbol) {
+      continue;
     }
+    allocated = New<CellNode>(
+        StatsEntry(ObjectTypeName(static_cast<ObjectType>(type - 1)),
+                   stats.allocated[type - 1]),
+        std::move(allocated));
+  }
+  auto &counters = stats.counters;
+  Value entries[] = {
+      StatsEntry("evaluations", counters.evaluations),
+      StatsEntry("lambda-calls", counters.lambda_calls),
+      StatsEntry("builtin-calls", counters.builtin_calls),
+      StatsEntry("global-lookups", counters.global_lookups),
+      StatsEntry("global-lookup-misses", counters.global_misses),
+      StatsEntry("max-call-depth", counters.max_call_depth),
+      StatsEntry("collections", stats.collections),
+      StatsEntry("live-objects", stats.live_objects),
+      StatsEntry("heap-bytes", stats.heap_bytes),
+      New<CellNode>(Intern("allocated"), std::move(allocated)),
+  };
+  Value list;
+  for (size_t i = std::size(entries); i > 0; --i) {
+    list = New<CellNode>(entries[i - 1], std::move(list));
+  }
+  return list;
+}
+////
+
+//// Однородные числовые векторы
+namespace {
+const char kNumericVectorError[] = "Wrong arguments for numeric vector func";
+
+void ToElement(const Value &arg, int64_t *out) {
+  if (arg.IsFixnum()) {
+    *out = arg.GetFixnum();
+    return;
+  }
+  auto number = AsNumber(arg);
+  if (!number || !number->GetValue().FitsInt64()) {
+    throw RuntimeError("s64vector element should be an exact 64-bit integer");
+  }
+  *out = number->GetValue().ToInt64();
+}
+
+void ToElement(const Value &arg, double *out) {
+  *out = ToDouble(arg, "f64vector element should be a real number");
+}
+
+Value FromElement(int64_t element) { return MakeInteger(element); }
+Value FromElement(double element) { return MakeFlonum(element); }
+
+template <class Node>
+Node *CheckNumericVector(const Value &obj) {
+  if (auto vector = As<Node>(obj.GetObject())) {
+    return vector;
+  }
+  throw RuntimeError(kNumericVectorError);
+}
+
+template <class Node>
+std::vector<typename Node::Element> ToElements(const Value *begin,
+                                               const Value *end) {
+  std::vector<typename Node::Element> elements(end - begin);
+  for (size_t index = 0; index < elements.size(); ++index) {
+    ToElement(begin[index], &elements[index]);
   }
   return elements;
 }
 
-void Object::PrintTo(std::ostream *out) { throw RuntimeError("WTF?"); }
-std::shared_ptr<Object> Object::Evaluate(std::shared_ptr<Scope> scp) {
-  throw RuntimeError("Placeholder");
+// Аргументы поэлементной операции: два вектора одного типа и длины
+template <class Node>
+bool MatchVectors(ArgList args, Node **lhs, Node **rhs) {
+  *lhs = As<Node>(args[0].GetObject());
+  *rhs = As<Node>(args[1].GetObject());
+  if (!*lhs || !*rhs) {
+    return false;
+  }
+  if ((*lhs)->Size() != (*rhs)->Size()) {
+    throw RuntimeError("Numeric vectors should have equal length");
+  }
+  return true;
+}
+
+template <class S64Kernel, class F64Kernel>
+Value Elementwise(ArgList args, S64Kernel s64, F64Kernel f64) {
+  if (args.size() != 2) {
+    throw RuntimeError(kNumericVectorError);
+  }
+  S64VectorNode *lhs_s64, *rhs_s64;
+  F64VectorNode *lhs_f64, *rhs_f64;
+  if (MatchVectors(args, &lhs_s64, &rhs_s64)) {
+    std::vector<int64_t> result(lhs_s64->Size());
+    if (s64(lhs_s64->Data(), rhs_s64->Data(), result.data(), result.size())) {
+      throw RuntimeError("s64vector element overflow");
+    }
+    return New<S64VectorNode>(std::move(result));
+  }
+  if (MatchVectors(args, &lhs_f64, &rhs_f64)) {
+    std::vector<double> result(lhs_f64->Size());
+    f64(lhs_f64->Data(), rhs_f64->Data(), result.data(), result.size());
+    return New<F64VectorNode>(std::move(result));
+  }
+  throw RuntimeError(kNumericVectorError);
+}
+
+template <class S64Kernel, class F64Kernel>
+Value Extremum(ArgList args, S64Kernel s64, F64Kernel f64) {
+  if (args.size() != 1) {
+    throw RuntimeError(kNumericVectorError);
+  }
+  if (auto vector = As<S64VectorNode>(args[0].GetObject())) {
+    if (vector->Size() == 0) {
+      throw RuntimeError("Empty numeric vector has no extremum");
+    }
+    return MakeInteger(s64(vector->Data(), vector->Size()));
+  }
+  auto vector = CheckNumericVector<F64VectorNode>(args[0]);
+  if (vector->Size() == 0) {
+    throw RuntimeError("Empty numeric vector has no extremum");
+  }
+  return MakeFlonum(f64(vector->Data(), vector->Size()));
+}
+} // namespace
+
+template <class Node>
+Value MakeNumericVector<Node>::Apply(ArgList args) {
+  if (args.empty() || args.size() > 2 || !args[0].IsFixnum() ||
+      args[0].GetFixnum() < 0) {
+    throw RuntimeError(kNumericVectorError);
+  }
+  typename Node::Element fill = 0;
+  if (args.size() == 2) {
+    ToElement(args[1], &fill);
+  }
+  return New<Node>(
+      std::vector<typename Node::Element>(args[0].GetFixnum(), fill));
+}
+template <class Node>
+Value NumericVectorCmd<Node>::Apply(ArgList args) {
+  return New<Node>(ToElements<Node>(args.begin(), args.end()));
+}
+template <class Node>
+Value NumericVectorCheck<Node>::Apply(ArgList args) {
+  if (args.size() != 1) {
+    throw RuntimeError(kNumericVectorError);
+  }
+  return Value::Bool(As<Node>(args[0].GetObject()));
+}
+template <class Node>
+Value NumericVectorLength<Node>::Apply(ArgList args) {
+  if (args.size() != 1) {
+    throw RuntimeError(kNumericVectorError);
+  }
+  return Value::Fixnum(CheckNumericVector<Node>(args[0])->Size());
+}
+template <class Node>
+Value NumericVectorRef<Node>::Apply(ArgList args) {
+  if (args.size() != 2) {
+    throw RuntimeError(kNumericVectorError);
+  }
+  auto vector = CheckNumericVector<Node>(args[0]);
+  return FromElement(vector->Data()[CheckIndex(vector->Size(), args[1])]);
+}
+template <class Node>
+Value NumericVectorSet<Node>::Apply(ArgList args) {
+  if (args.size() != 3) {
+    throw RuntimeError(kNumericVectorError);
+  }
+  auto vector = CheckNumericVector<Node>(args[0]);
+  ToElement(args[2], &vector->Data()[CheckIndex(vector->Size(), args[1])]);
+  return Value(this);
+}
+template <class Node>
+Value NumericVectorToList<Node>::Apply(ArgList args) {
+  if (args.size() != 1) {
+    throw RuntimeError(kNumericVectorError);
+  }
+  auto vector = CheckNumericVector<Node>(args[0]);
+  Value list;
+  for (auto index = vector->Size(); index > 0; --index) {
+    list = New<CellNode>(FromElement(vector->Data()[index - 1]), std::move(list));
+  }
+  return list;
+}
+template <class Node>
+Value ListToNumericVector<Node>::Apply(ArgList args) {
+  if (args.size() != 1 || (args[0] && !IsCell(args[0]))) {
+    throw RuntimeError(kNumericVectorError);
+  }
+  auto elements = ToVector(args[0]);
+  return New<Node>(
+      ToElements<Node>(elements.data(), elements.data() + elements.size()));
+}
+
+template class MakeNumericVector<S64VectorNode>;
+template class MakeNumericVector<F64VectorNode>;
+template class NumericVectorCmd<S64VectorNode>;
+template class NumericVectorCmd<F64VectorNode>;
+template class NumericVectorCheck<S64VectorNode>;
+template class NumericVectorCheck<F64VectorNode>;
+template class NumericVectorLength<S64VectorNode>;
+template class NumericVectorLength<F64VectorNode>;
+template class NumericVectorRef<S64VectorNode>;
+template class NumericVectorRef<F64VectorNode>;
+template class NumericVectorSet<S64VectorNode>;
+template class NumericVectorSet<F64VectorNode>;
+template class NumericVectorToList<S64VectorNode>;
+template class NumericVectorToList<F64VectorNode>;
+template class ListToNumericVector<S64VectorNode>;
+template class ListToNumericVector<F64VectorNode>;
+
+Value NumericVectorAdd::Apply(ArgList args) {
+  return Elementwise(args, AddS64, AddF64);
+}
+Value NumericVectorMul::Apply(ArgList args) {
+  return Elementwise(args, MulS64, MulF64);
 }
-std::shared_ptr<Object>
-Object::Apply(Scope &scp, std::vector<std::shared_ptr<Object>> &params) {
-  throw RuntimeError("Placeholder");
+Value NumericVectorMin::Apply(ArgList args) {
+  return Extremum(args, MinS64, MinF64);
 }
-std::shared_ptr<Object> NumberNode::Evaluate(std::shared_ptr<Scope> scp) {
-  return shared_from_this();
+Value NumericVectorMax::Apply(ArgList args) {
+  return Extremum(args, MaxS64, MaxF64);
+}
+
+// Точная сумма не переполняется: если она не помещается в int64,
+// high * 2^32 + low собирается в bignum
+Value NumericVectorSum::Apply(ArgList args) {
+  if (args.size() != 1) {
+    throw RuntimeError(kNumericVectorError);
+  }
+  if (auto vector = As<S64VectorNode>(args[0].GetObject())) {
+    auto sum = SumS64(vector->Data(), vector->Size());
+    const int64_t base = int64_t(1) << 32;
+    int64_t high, result;
+    if (!MulOverflow(sum.high, base, &high) &&
+        !AddOverflow(high, static_cast<int64_t>(sum.low), &result)) {
+      return MakeInteger(result);
+    }
+    return MakeInteger(BigInt(sum.high) * BigInt(base) +
+                       BigInt(static_cast<int64_t>(sum.low)));
+  }
+  auto vector = CheckNumericVector<F64VectorNode>(args[0]);
+  return MakeFlonum(SumF64(vector->Data(), vector->Size()));
+}
+
+// При переполнении int64 скалярное произведение досчитывается в bignum
+Value NumericVectorDot::Apply(ArgList args) {
+  if (args.size() != 2) {
+    throw RuntimeError(kNumericVectorError);
+  }
+  S64VectorNode *lhs_s64, *rhs_s64;
+  F64VectorNode *lhs_f64, *rhs_f64;
+  if (MatchVectors(args, &lhs_s64, &rhs_s64)) {
+    int64_t result;
+    if (!DotS64(lhs_s64->Data(), rhs_s64->Data(), lhs_s64->Size(), &result)) {
+      return MakeInteger(result);
+    }
+    BigInt sum;
+    for (size_t i = 0; i < lhs_s64->Size(); ++i) {
+      sum = sum + BigInt(lhs_s64->Data()[i]) * BigInt(rhs_s64->Data()[i]);
+    }
+    return MakeInteger(std::move(sum));
+  }
+  if (MatchVectors(args, &lhs_f64, &rhs_f64)) {
+    return MakeFlonum(DotF64(lhs_f64->Data(), rhs_f64->Data(), lhs_f64->Size()));
+  }
+  throw RuntimeError(kNumericVectorError);
 }
-void NumberNode::PrintTo(std::ostream *out) { *out << number_; }
-int64_t NumberNode::GetValue() { return number_; }
-NumberNode::NumberNode(int num) : number_(num) {}
 
-std::shared_ptr<Object> ReadList(Tokenizer *tokenizer) {
-  std::shared_ptr<CellNode> head = nullptr;
-  std::shared_ptr<CellNode> tail = nullptr;
+// s64: результат считается во временный буфер, чтобы при переполнении
+// y остался прежним
+Value NumericVectorAxpy::Apply(ArgList args) {
+  if (args.size() != 3) {
+    throw RuntimeError(kNumericVectorError);
+  }
+  ArgList vectors(args.begin() + 1, 2);
+  S64VectorNode *x_s64, *y_s64;
+  F64VectorNode *x_f64, *y_f64;
+  if (MatchVectors(vectors, &x_s64, &y_s64)) {
+    int64_t scale;
+    ToElement(args[0], &scale);
+    std::vector<int64_t> result(y_s64->Size());
+    if (AxpyS64(scale, x_s64->Data(), y_s64->Data(), result.data(),
+                result.size())) {
+      throw RuntimeError("s64vector element overflow");
+    }
+    y_s64->Elements().swap(result);
+  } else if (MatchVectors(vectors, &x_f64, &y_f64)) {
+    double scale;
+    ToElement(args[0], &scale);
+    AxpyF64(scale, x_f64->Data(), y_f64->Data(), y_f64->Size());
+  } else {
+    throw RuntimeError(kNumericVectorError);
+  }
+  return Value(this);
+}
+void NumericVectorAxpy::PrintTo(std::string *out) {}
+
+template <>
+void S64VectorNode::PrintTo(std::string *out) {
+  *out += "#s64(";
+  for (size_t index = 0; index < elements_.size(); ++index) {
+    if (index) {
+      *out += ' ';
+    }
+    *out += std::to_string(elements_[index]);
+  }
+  *out += ')';
+}
+template <>
+void F64VectorNode::PrintTo(std::string *out) {
+  *out += "#f64(";
+  for (size_t index = 0; index < elements_.size(); ++index) {
+    if (index) {
+      *out += ' ';
+    }
+    PrintDouble(elements_[index], out);
+  }
+  *out += ')';
+}
+////
+
+Value ReadList(Tokenizer *tokenizer) {
+  CellNode *head = nullptr;
+  CellNode *tail = nullptr;
   auto cur_token = tokenizer->GetToken();
   auto bracket_token = std::get_if<BracketToken>(&cur_token);
   tokenizer->Next();
@@ -724,14 +1420,14 @@ std::shared_ptr<Object> ReadList(Tokenizer *tokenizer) {
       return head;
     } else {
       if (!head) {
-        head = std::make_shared<CellNode>();
+        head = New<CellNode>();
         head->SetFirst(Read(tokenizer));
       } else if (!tail) {
-        tail = std::make_shared<CellNode>();
+        tail = New<CellNode>();
         tail->SetFirst(Read(tokenizer));
         head->SetSecond(tail);
       } else {
-        auto token = std::make_shared<CellNode>();
+        auto token = New<CellNode>();
         token->SetFirst(Read(tokenizer));
         tail->SetSecond(token);
         tail = token;
@@ -746,37 +1442,38 @@ std::shared_ptr<Object> ReadList(Tokenizer *tokenizer) {
   return head;
 }
 
-std::shared_ptr<Object> Read(Tokenizer *tokenizer) {
+Value Read(Tokenizer *tokenizer) {
   auto cur_token = tokenizer->GetToken();
   if (auto val = std::get_if<ConstantToken>(&cur_token)) {
-    auto new_node = std::make_shared<NumberNode>(val->value);
+    auto new_node = val->digits.empty() ? MakeInteger(val->value)
+                                        : MakeInteger(BigInt::Parse(val->digits));
+    tokenizer->Next();
+    return new_node;
+  } else if (auto val = std::get_if<FlonumToken>(&cur_token)) {
+    auto new_node = MakeFlonum(val->value);
     tokenizer->Next();
     return new_node;
   } else if (auto val = std::get_if<SymbolToken>(&cur_token)) {
+    Value new_node(Intern(val->name));
     tokenizer->Next();
-    if (val->name != "\n") {
-      auto new_node = std::make_shared<SymbolNode>(val->name);
-      return new_node;
-    }
-    return Read(tokenizer);
+    return new_node;
   } else if (auto val = std::get_if<QuoteToken>(&cur_token)) {
     tokenizer->Next();
     auto cur_token = tokenizer->GetToken();
     auto bracket_token = std::get_if<BracketToken>(&cur_token);
-    std::shared_ptr<Object> res_list;
+    Value res_list;
     if (bracket_token) {
       res_list = ReadList(tokenizer);
+      tokenizer->Next();
     } else {
-      res_list = std::make_shared<SymbolNode>(
-          std::get_if<SymbolToken>(&cur_token)->name);
+      // Символ, число или вектор: Read сам переходит к следующему токену
+      res_list = Read(tokenizer);
     }
-    auto quote_node = std::make_shared<SymbolNode>("\'");
-    auto root_node = std::make_shared<CellNode>();
-    auto main_node_for_list = std::make_shared<CellNode>();
-    root_node->SetFirst(quote_node);
+    auto root_node = New<CellNode>();
+    auto main_node_for_list = New<CellNode>();
+    root_node->SetFirst(Value(Intern("\'")));
     main_node_for_list->SetFirst(res_list);
     root_node->SetSecond(main_node_for_list);
-    tokenizer->Next();
     return root_node;
   } else if (std::get_if<BracketToken>(&cur_token) &&
              (*std::get_if<BracketToken>(&cur_token)) == BracketToken::OPEN) {
@@ -787,6 +1484,18 @@ std::shared_ptr<Object> Read(Tokenizer *tokenizer) {
       throw SyntaxError("No closing bracket");
     }
     return new_node;
+  } else if (auto val = std::get_if<StringToken>(&cur_token)) {
+    Value new_node(New<StringNode>(std::string(val->text)));
+    tokenizer->Next();
+    return new_node;
+  } else if (std::get_if<VectorToken>(&cur_token)) {
+    // Элементы читаются как список и переносятся в непрерывный буфер
+    auto elements = ToVector(ReadList(tokenizer));
+    tokenizer->Next();
+    if (tokenizer->BracketBalance() < 0) {
+      throw SyntaxError("No closing bracket");
+    }
+    return New<VectorNode>(std::move(elements));
   } else {
     throw SyntaxError{"Krivoi vvod"};
   }
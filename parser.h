@@ -3,17 +3,22 @@
 #include <memory>
 #include <exception>
 #include "tokenizer.h"
+#include "bigint.h"
+#include "frame.h"
+#include "hash_table.h"
+#include "printer.h"
+#include "value.h"
 #include <vector>
 #include <iostream>
 #include <cassert>
 
 class Scope;
+class Compiler;
+class CompiledNode;
+struct LambdaCode;
 
 //// Классы ошибок
-struct SyntaxError : public std::runtime_error {
-    explicit SyntaxError(const std::string& what) : std::runtime_error(what) {
-    }
-};
+// SyntaxError объявлен в tokenizer.h: его бросает и лексер
 
 struct RuntimeError : public std::runtime_error {
     explicit RuntimeError(const std::string& what) : std::runtime_error(what) {
@@ -25,343 +30,854 @@ struct NameError : public std::runtime_error {
     }
 };
 
-//// Базовый object
-class Object : public std::enable_shared_from_this<Object> {
-public:
-    virtual ~Object() = default;
-    virtual void PrintTo(std::ostream* out);
-    virtual std::shared_ptr<Object> Evaluate(std::shared_ptr<Scope> scp);
-    virtual std::shared_ptr<Object> Apply(Scope& scp, std::vector<std::shared_ptr<Object>>& params);
-};
-
-inline void PrintTo(const std::shared_ptr<Object>& obj, std::ostream* out);
-inline std::string Print(const std::shared_ptr<Object>& obj);
-std::vector<std::shared_ptr<Object>> ToVector(const std::shared_ptr<Object>& head);
+std::vector<Value> ToVector(const Value& head);
 
-//// класс Boolean
-class Boolean : public Object {
+//// Аргументы вызова функции: срез значений, уже лежащих у вызывающего
+// (во временном массиве дерева или на стеке VM), без копирования в вектор
+class ArgList {
 public:
-    Boolean(bool val);
-    void PrintTo(std::ostream* out) override;
-    bool GetVal();
+    ArgList(const Value* data, size_t size) : data_(data), size_(size) {
+    }
+    ArgList(const std::vector<Value>& values) : data_(values.data()), size_(values.size()) {
+    }
+
+    const Value* begin() const {
+        return data_;
+    }
+    const Value* end() const {
+        return data_ + size_;
+    }
+    size_t size() const {
+        return size_;
+    }
+    bool empty() const {
+        return size_ == 0;
+    }
+    const Value& operator[](size_t i) const {
+        return data_[i];
+    }
 
 private:
-    bool val_ = true;
+    const Value* data_;
+    size_t size_;
 };
 ////
 
 //// Класс функций
 class Function : public Object {
 public:
-    virtual std::shared_ptr<Object> Apply(const std::shared_ptr<Scope>& scp,
-                                          const std::vector<std::shared_ptr<Object>>& args) = 0;
-    virtual void PrintTo(std::ostream* out) override;
-    virtual std::shared_ptr<Object> Evaluate(std::shared_ptr<Scope> scp);
+    Function() : Object(ObjectType::kBuiltin) {
+    }
+    static bool HasType(ObjectType type) {
+        return type == ObjectType::kBuiltin || type == ObjectType::kLambda;
+    }
+    virtual Value Apply(ArgList args) = 0;
+    virtual void PrintTo(std::string* out) override;
+
+protected:
+    explicit Function(ObjectType type) : Object(type) {
+    }
 };
 
 class Plus : public Function {
 public:
-    std::shared_ptr<Object> Apply(const std::shared_ptr<Scope>& scp,
-                                  const std::vector<std::shared_ptr<Object>>& args) override;
+    Value Apply(ArgList args) override;
 };
 
 class Minus : public Function {
 public:
-    std::shared_ptr<Object> Apply(const std::shared_ptr<Scope>& scp,
-                                  const std::vector<std::shared_ptr<Object>>& args) override;
+    Value Apply(ArgList args) override;
 };
 
 class Divide : public Function {
 public:
-    std::shared_ptr<Object> Apply(const std::shared_ptr<Scope>& scp,
-                                  const std::vector<std::shared_ptr<Object>>& args) override;
+    Value Apply(ArgList args) override;
 };
 
 class Multiply : public Function {
 public:
-    std::shared_ptr<Object> Apply(const std::shared_ptr<Scope>& scp,
-                                  const std::vector<std::shared_ptr<Object>>& args) override;
+    Value Apply(ArgList args) override;
+};
+
+class Quotient : public Function {
+public:
+    Value Apply(ArgList args) override;
+};
+
+class Remainder : public Function {
+public:
+    Value Apply(ArgList args) override;
+};
+
+class ExactToInexact : public Function {
+public:
+    Value Apply(ArgList args) override;
 };
 
 class LessOrEqual : public Function {
 public:
-    std::shared_ptr<Object> Apply(const std::shared_ptr<Scope>& scp,
-                                  const std::vector<std::shared_ptr<Object>>& args) override;
+    Value Apply(ArgList args) override;
 };
 
 class Less : public Function {
 public:
-    std::shared_ptr<Object> Apply(const std::shared_ptr<Scope>& scp,
-                                  const std::vector<std::shared_ptr<Object>>& args) override;
+    Value Apply(ArgList args) override;
 };
 
 class GreaterOrEqual : public Function {
 public:
-    std::shared_ptr<Object> Apply(const std::shared_ptr<Scope>& scp,
-                                  const std::vector<std::shared_ptr<Object>>& args) override;
+    Value Apply(ArgList args) override;
 };
 
 class Greater : public Function {
 public:
-    std::shared_ptr<Object> Apply(const std::shared_ptr<Scope>& scp,
-                                  const std::vector<std::shared_ptr<Object>>& args) override;
+    Value Apply(ArgList args) override;
 };
 
 class Equal : public Function {
 public:
-    std::shared_ptr<Object> Apply(const std::shared_ptr<Scope>& scp,
-                                  const std::vector<std::shared_ptr<Object>>& args) override;
+    Value Apply(ArgList args) override;
 };
 
 class Max : public Function {
 public:
-    std::shared_ptr<Object> Apply(const std::shared_ptr<Scope>& scp,
-                                  const std::vector<std::shared_ptr<Object>>& args) override;
+    Value Apply(ArgList args) override;
 };
 
 class Min : public Function {
 public:
-    std::shared_ptr<Object> Apply(const std::shared_ptr<Scope>& scp,
-                                  const std::vector<std::shared_ptr<Object>>& args) override;
+    Value Apply(ArgList args) override;
 };
 
 class Abs : public Function {
 public:
-    std::shared_ptr<Object> Apply(const std::shared_ptr<Scope>& scp,
-                                  const std::vector<std::shared_ptr<Object>>& args) override;
+    Value Apply(ArgList args) override;
 };
 
 class NumberCheck : public Function {
 public:
-    std::shared_ptr<Object> Apply(const std::shared_ptr<Scope>& scp,
-                                  const std::vector<std::shared_ptr<Object>>& args) override;
+    Value Apply(ArgList args) override;
 };
 
 class PairCheck : public Function {
 public:
-    std::shared_ptr<Object> Apply(const std::shared_ptr<Scope>& scp,
-                                  const std::vector<std::shared_ptr<Object>>& args) override;
+    Value Apply(ArgList args) override;
 };
 
 class NullCheck : public Function {
 public:
-    std::shared_ptr<Object> Apply(const std::shared_ptr<Scope>& scp,
-                                  const std::vector<std::shared_ptr<Object>>& args) override;
+    Value Apply(ArgList args) override;
 };
 
 class ListCheck : public Function {
 public:
-    std::shared_ptr<Object> Apply(const std::shared_ptr<Scope>& scp,
-                                  const std::vector<std::shared_ptr<Object>>& args) override;
+    Value Apply(ArgList args) override;
 };
 
 class BooleanCheck : public Function {
 public:
-    std::shared_ptr<Object> Apply(const std::shared_ptr<Scope>& scp,
-                                  const std::vector<std::shared_ptr<Object>>& args) override;
+    Value Apply(ArgList args) override;
 };
 
 class SymbolCheck : public Function {
 public:
-    std::shared_ptr<Object> Apply(const std::shared_ptr<Scope>& scp,
-                                  const std::vector<std::shared_ptr<Object>>& args) override;
+    Value Apply(ArgList args) override;
 };
 
 class Cons : public Function {
 public:
-    std::shared_ptr<Object> Apply(const std::shared_ptr<Scope>& scp,
-                                  const std::vector<std::shared_ptr<Object>>& args) override;
+    Value Apply(ArgList args) override;
+};
+
+class Eq : public Function {
+public:
+    Value Apply(ArgList args) override;
 };
 
 class Not : public Function {
 public:
-    std::shared_ptr<Object> Apply(const std::shared_ptr<Scope>& scp,
-                                  const std::vector<std::shared_ptr<Object>>& args) override;
+    Value Apply(ArgList args) override;
+};
+
+class StructEqual : public Function {
+public:
+    Value Apply(ArgList args) override;
 };
 
 ////
 
 //// Класс синтаксиса (особых выражений)
+// Особая форма не вычисляется, а разворачивается компилятором в CompiledNode
 class Syntax : public Object {
 public:
-    virtual std::shared_ptr<Object> Apply(const std::shared_ptr<Scope>& scp,
-                                          const std::vector<std::shared_ptr<Object>>& args) = 0;
-    virtual void PrintTo(std::ostream* out) override;
-    virtual std::shared_ptr<Object> Evaluate(std::shared_ptr<Scope> scp);
+    Syntax() : Object(ObjectType::kSyntax) {
+    }
+    static bool HasType(ObjectType type) {
+        return type == ObjectType::kSyntax;
+    }
+    virtual std::unique_ptr<CompiledNode> Compile(
+        Compiler* compiler, const std::vector<Value>& args) = 0;
+    virtual void PrintTo(std::string* out) override;
 };
 
 class Quote : public Syntax {
 public:
-    std::shared_ptr<Object> Apply(const std::shared_ptr<Scope>& scp,
-                                  const std::vector<std::shared_ptr<Object>>& args) override;
-    void PrintTo(std::ostream* out) override;
+    std::unique_ptr<CompiledNode> Compile(Compiler* compiler,
+                                          const std::vector<Value>& args) override;
+    void PrintTo(std::string* out) override;
 };
 
 class If : public Syntax {
 public:
-    std::shared_ptr<Object> Apply(const std::shared_ptr<Scope>& scp,
-                                  const std::vector<std::shared_ptr<Object>>& args) override;
+    std::unique_ptr<CompiledNode> Compile(Compiler* compiler,
+                                          const std::vector<Value>& args) override;
+};
+
+class Define : public Syntax {
+public:
+    std::unique_ptr<CompiledNode> Compile(Compiler* compiler,
+                                          const std::vector<Value>& args) override;
+    void PrintTo(std::string* out) override;
 };
 
-class Car : public Syntax {
+class Set : public Syntax {
 public:
-    std::shared_ptr<Object> Apply(const std::shared_ptr<Scope>& scp,
-                                  const std::vector<std::shared_ptr<Object>>& args) override;
+    std::unique_ptr<CompiledNode> Compile(Compiler* compiler,
+                                          const std::vector<Value>& args) override;
+    void PrintTo(std::string* out) override;
 };
 
-class Cdr : public Syntax {
+class And : public Syntax {
 public:
-    std::shared_ptr<Object> Apply(const std::shared_ptr<Scope>& scp,
-                                  const std::vector<std::shared_ptr<Object>>& args) override;
+    std::unique_ptr<CompiledNode> Compile(Compiler* compiler,
+                                          const std::vector<Value>& args) override;
 };
 
-class Define : public Syntax {
+class Or : public Syntax {
 public:
-    std::shared_ptr<Object> Apply(const std::shared_ptr<Scope>& scp,
-                                  const std::vector<std::shared_ptr<Object>>& args) override;
-    void PrintTo(std::ostream* out) override;
+    std::unique_ptr<CompiledNode> Compile(Compiler* compiler,
+                                          const std::vector<Value>& args) override;
 };
 
-class SetCar : public Syntax {
+class Lambda : public Syntax {
 public:
-    std::shared_ptr<Object> Apply(const std::shared_ptr<Scope>& scp,
-                                  const std::vector<std::shared_ptr<Object>>& args) override;
-    void PrintTo(std::ostream* out) override;
+    std::unique_ptr<CompiledNode> Compile(Compiler* compiler,
+                                          const std::vector<Value>& args) override;
 };
 
-class SetCdr : public Syntax {
+class Profile : public Syntax {
 public:
-    std::shared_ptr<Object> Apply(const std::shared_ptr<Scope>& scp,
-                                  const std::vector<std::shared_ptr<Object>>& args) override;
-    void PrintTo(std::ostream* out) override;
+    std::unique_ptr<CompiledNode> Compile(Compiler* compiler,
+                                          const std::vector<Value>& args) override;
 };
 
-class Set : public Syntax {
+////
+
+//// Функции над списками
+class Car : public Function {
 public:
-    std::shared_ptr<Object> Apply(const std::shared_ptr<Scope>& scp,
-                                  const std::vector<std::shared_ptr<Object>>& args) override;
-    void PrintTo(std::ostream* out) override;
+    Value Apply(ArgList args) override;
 };
 
-class And : public Syntax {
+class Cdr : public Function {
 public:
-    std::shared_ptr<Object> Apply(const std::shared_ptr<Scope>& scp,
-                                  const std::vector<std::shared_ptr<Object>>& args) override;
+    Value Apply(ArgList args) override;
 };
 
-class Or : public Syntax {
+class SetCar : public Function {
 public:
-    std::shared_ptr<Object> Apply(const std::shared_ptr<Scope>& scp,
-                                  const std::vector<std::shared_ptr<Object>>& args) override;
+    Value Apply(ArgList args) override;
+    void PrintTo(std::string* out) override;
 };
 
-class ListCmd : public Syntax {
+class SetCdr : public Function {
 public:
-    std::shared_ptr<Object> Apply(const std::shared_ptr<Scope>& scp,
-                                  const std::vector<std::shared_ptr<Object>>& args) override;
+    Value Apply(ArgList args) override;
+    void PrintTo(std::string* out) override;
 };
 
-class ListRef : public Syntax {
+class ListCmd : public Function {
 public:
-    std::shared_ptr<Object> Apply(const std::shared_ptr<Scope>& scp,
-                                  const std::vector<std::shared_ptr<Object>>& args) override;
+    Value Apply(ArgList args) override;
 };
 
-class ListTail : public Syntax {
+class ListRef : public Function {
 public:
-    std::shared_ptr<Object> Apply(const std::shared_ptr<Scope>& scp,
-                                  const std::vector<std::shared_ptr<Object>>& args) override;
+    Value Apply(ArgList args) override;
 };
 
-class Lambda : public Syntax {
+class ListTail : public Function {
 public:
-    std::shared_ptr<Object> Apply(const std::shared_ptr<Scope>& scp,
-                                  const std::vector<std::shared_ptr<Object>>& args) override;
+    Value Apply(ArgList args) override;
 };
 
+////
+
+//// Функции над векторами
+class MakeVector : public Function {
+public:
+    Value Apply(ArgList args) override;
+};
+
+class VectorCmd : public Function {
+public:
+    Value Apply(ArgList args) override;
+};
+
+class VectorCheck : public Function {
+public:
+    Value Apply(ArgList args) override;
+};
+
+class VectorLength : public Function {
+public:
+    Value Apply(ArgList args) override;
+};
+
+class VectorRef : public Function {
+public:
+    Value Apply(ArgList args) override;
+};
+
+class VectorSet : public Function {
+public:
+    Value Apply(ArgList args) override;
+    void PrintTo(std::string* out) override;
+};
+
+class VectorToList : public Function {
+public:
+    Value Apply(ArgList args) override;
+};
+
+class ListToVector : public Function {
+public:
+    Value Apply(ArgList args) override;
+};
+////
+
+//// Однородные числовые векторы (SRFI-4)
+// Шаблоны инстанцируются в parser.cpp для S64VectorNode и F64VectorNode
+template <class Node>
+class MakeNumericVector : public Function {
+public:
+    Value Apply(ArgList args) override;
+};
+
+template <class Node>
+class NumericVectorCmd : public Function {
+public:
+    Value Apply(ArgList args) override;
+};
+
+template <class Node>
+class NumericVectorCheck : public Function {
+public:
+    Value Apply(ArgList args) override;
+};
+
+template <class Node>
+class NumericVectorLength : public Function {
+public:
+    Value Apply(ArgList args) override;
+};
+
+template <class Node>
+class NumericVectorRef : public Function {
+public:
+    Value Apply(ArgList args) override;
+};
+
+template <class Node>
+class NumericVectorSet : public Function {
+public:
+    Value Apply(ArgList args) override;
+    void PrintTo(std::string* out) override {
+    }
+};
+
+template <class Node>
+class NumericVectorToList : public Function {
+public:
+    Value Apply(ArgList args) override;
+};
+
+template <class Node>
+class ListToNumericVector : public Function {
+public:
+    Value Apply(ArgList args) override;
+};
+
+// Массовые операции принимают векторы обоих типов; аргументы одной
+// операции должны быть одного типа и длины
+class NumericVectorAdd : public Function {
+public:
+    Value Apply(ArgList args) override;
+};
+
+class NumericVectorMul : public Function {
+public:
+    Value Apply(ArgList args) override;
+};
+
+class NumericVectorDot : public Function {
+public:
+    Value Apply(ArgList args) override;
+};
+
+class NumericVectorSum : public Function {
+public:
+    Value Apply(ArgList args) override;
+};
+
+class NumericVectorMin : public Function {
+public:
+    Value Apply(ArgList args) override;
+};
+
+class NumericVectorMax : public Function {
+public:
+    Value Apply(ArgList args) override;
+};
+
+// (uvector-axpy! a x y): y := a * x + y
+class NumericVectorAxpy : public Function {
+public:
+    Value Apply(ArgList args) override;
+    void PrintTo(std::string* out) override;
+};
+////
+
+//// Хеш-таблицы (SRFI-69)
+// Ключи сравниваются как в equal?
+class MakeHashTable : public Function {
+public:
+    Value Apply(ArgList args) override;
+};
+
+class HashTableCheck : public Function {
+public:
+    Value Apply(ArgList args) override;
+};
+
+// (hash-table-ref table key [thunk]): без ключа вызывает thunk или
+// бросает ошибку
+class HashTableRef : public Function {
+public:
+    Value Apply(ArgList args) override;
+};
+
+class HashTableRefDefault : public Function {
+public:
+    Value Apply(ArgList args) override;
+};
+
+class HashTableSet : public Function {
+public:
+    Value Apply(ArgList args) override;
+    void PrintTo(std::string* out) override;
+};
+
+class HashTableDelete : public Function {
+public:
+    Value Apply(ArgList args) override;
+    void PrintTo(std::string* out) override;
+};
+
+class HashTableContains : public Function {
+public:
+    Value Apply(ArgList args) override;
+};
+
+class HashTableCount : public Function {
+public:
+    Value Apply(ArgList args) override;
+};
+
+class HashTableKeys : public Function {
+public:
+    Value Apply(ArgList args) override;
+};
+
+class HashTableValues : public Function {
+public:
+    Value Apply(ArgList args) override;
+};
+
+class HashTableToAlist : public Function {
+public:
+    Value Apply(ArgList args) override;
+};
+
+// (hash-table-walk table proc): proc вызывается с ключом и значением
+class HashTableWalk : public Function {
+public:
+    Value Apply(ArgList args) override;
+    void PrintTo(std::string* out) override;
+};
+////
+
+//// Строки
+class StringCheck : public Function {
+public:
+    Value Apply(ArgList args) override;
+};
+
+class StringLength : public Function {
+public:
+    Value Apply(ArgList args) override;
+};
+
+class StringAppend : public Function {
+public:
+    Value Apply(ArgList args) override;
+};
+
+// (substring str start [end])
+class Substring : public Function {
+public:
+    Value Apply(ArgList args) override;
+};
+
+class StringEqual : public Function {
+public:
+    Value Apply(ArgList args) override;
+};
+
+class StringToSymbol : public Function {
+public:
+    Value Apply(ArgList args) override;
+};
+
+class SymbolToString : public Function {
+public:
+    Value Apply(ArgList args) override;
+};
+
+class NumberToString : public Function {
+public:
+    Value Apply(ArgList args) override;
+};
+////
+
+//// Строковые порты вывода
+class OpenOutputString : public Function {
+public:
+    Value Apply(ArgList args) override;
+};
+
+class GetOutputString : public Function {
+public:
+    Value Apply(ArgList args) override;
+};
+
+// (write-string str port)
+class WriteString : public Function {
+public:
+    Value Apply(ArgList args) override;
+    void PrintTo(std::string* out) override;
+};
+
+// (display obj port): строки без кавычек
+class Display : public Function {
+public:
+    Value Apply(ArgList args) override;
+    void PrintTo(std::string* out) override;
+};
+
+// (write obj port): в том же виде, что печатает REPL
+class Write : public Function {
+public:
+    Value Apply(ArgList args) override;
+    void PrintTo(std::string* out) override;
+};
+
+class Newline : public Function {
+public:
+    Value Apply(ArgList args) override;
+    void PrintTo(std::string* out) override;
+};
+////
+
+//// Статистика выполнения
+// (runtime-stats): ассоциативный список счётчиков потока (runtime_stats.h),
+// созданные в куче объекты по видам лежат под ключом allocated
+class RuntimeStatsCmd : public Function {
+public:
+    Value Apply(ArgList args) override;
+};
+////
+
+// Замыкание: скомпилированное тело разделяется всеми экземплярами одной лямбды
 class LambdaFunc : public Function {
 public:
-    std::shared_ptr<Object> Apply(const std::shared_ptr<Scope>& scp,
-                                  const std::vector<std::shared_ptr<Object>>& args) override;
-    std::shared_ptr<Scope> local_scope_;
-    std::vector<std::shared_ptr<Object>> params_;
-    std::vector<std::shared_ptr<Object>> lambda_func;
+    LambdaFunc() : Function(ObjectType::kLambda) {
+    }
+    static bool HasType(ObjectType type) {
+        return type == ObjectType::kLambda;
+    }
+    Value Apply(ArgList args) override;
+    void Trace(Heap* heap) override;
+    size_t ByteSize() const override;
+    std::shared_ptr<LambdaCode> code_;
+    // Кадр, в котором создано замыкание: начало цепочки для свободных переменных
+    Frame* env_ = nullptr;
+    Scope* globals_ = nullptr;
 };
 
 //// Виды нод в дереве
+// Ноды выделяются из пулов своего типа (SlabPool), а не общим malloc:
+// пары и числа одного потока лежат плотно, по несколько сотен на slab
+
+// Целые вне диапазона fixnum: в куче лежат только они
 class NumberNode : public Object {
 public:
-    NumberNode(int num);
-    std::shared_ptr<Object> Evaluate(std::shared_ptr<Scope> scp) override;
-    virtual void PrintTo(std::ostream* out) override;
-    int64_t GetValue();
+    explicit NumberNode(BigInt num);
+    static bool HasType(ObjectType type) {
+        return type == ObjectType::kNumber;
+    }
+    static void* operator new(size_t size);
+    static void operator delete(void* ptr);
+    virtual void PrintTo(std::string* out) override;
+    size_t ByteSize() const override;
+    const BigInt& GetValue();
+
+private:
+    BigInt number_;
+};
+
+// Вещественное число. Арифметика держит промежуточные double в регистрах
+// и упаковывает только итог
+class FlonumNode : public Object {
+public:
+    explicit FlonumNode(double value);
+    static bool HasType(ObjectType type) {
+        return type == ObjectType::kFlonum;
+    }
+    static void* operator new(size_t size);
+    static void operator delete(void* ptr);
+    virtual void PrintTo(std::string* out) override;
+    size_t ByteSize() const override;
+    double GetValue();
 
 private:
-    int64_t number_;
+    double value_;
 };
 
+typedef uint32_t SymbolId;
+
+// Создаётся только через Intern: одинаковые имена разделяют один объект.
+// Символы постоянны и не участвуют в сборке мусора
 class SymbolNode : public Object {
 public:
-    SymbolNode(std::string name);
-    virtual std::shared_ptr<Object> Evaluate(std::shared_ptr<Scope> scp);
-    virtual void PrintTo(std::ostream* out) override;
-    std::string GetName();
+    SymbolNode(std::string name, SymbolId id);
+    static bool HasType(ObjectType type) {
+        return type == ObjectType::kSymbol;
+    }
+    static void* operator new(size_t size);
+    static void operator delete(void* ptr);
+    virtual void PrintTo(std::string* out) override;
+    const std::string& GetName();
+    SymbolId GetId();
 
 private:
     std::string name_;
+    SymbolId id_;
 };
 
 class CellNode : public Object {
 public:
     CellNode();
-    CellNode(Object first, Object second);
+    CellNode(Value first, Value second);
+    static bool HasType(ObjectType type) {
+        return type == ObjectType::kCell;
+    }
+    static void* operator new(size_t size);
+    static void operator delete(void* ptr);
 
-    std::shared_ptr<Object> Evaluate(std::shared_ptr<Scope> scp) override;
-    virtual void PrintTo(std::ostream* out) override;
-    auto GetFirst();
-    auto GetSecond();
-    void SetFirst(std::shared_ptr<Object> first);
-    void SetSecond(std::shared_ptr<Object> second);
+    virtual void PrintTo(std::string* out) override;
+    void Trace(Heap* heap) override;
+    size_t ByteSize() const override;
+    const Value& GetFirst();
+    const Value& GetSecond();
+    void SetFirst(Value first);
+    void SetSecond(Value second);
 
 private:
-    std::shared_ptr<Object> number_first_ = nullptr;
-    std::shared_ptr<Object> number_second_ = nullptr;
+    Value number_first_;
+    Value number_second_;
 };
+
+// Вектор: элементы лежат подряд в одном буфере, доступ по индексу за O(1)
+class VectorNode : public Object {
+public:
+    explicit VectorNode(std::vector<Value> elements);
+    static bool HasType(ObjectType type) {
+        return type == ObjectType::kVector;
+    }
+
+    virtual void PrintTo(std::string* out) override;
+    void Trace(Heap* heap) override;
+    size_t ByteSize() const override;
+    size_t Size() const {
+        return elements_.size();
+    }
+    const Value& Get(size_t index) const {
+        return elements_[index];
+    }
+    void Set(size_t index, Value value) {
+        elements_[index] = std::move(value);
+    }
+    const std::vector<Value>& Elements() const {
+        return elements_;
+    }
+
+private:
+    std::vector<Value> elements_;
+};
+
+// Неизменяемая строка. Нода берётся из пула, а короткий текст
+// std::string держит прямо в ней (small-string optimization), так что
+// строка из нескольких символов - одно выделение из slab'а
+class StringNode : public Object {
+public:
+    explicit StringNode(std::string value);
+    static bool HasType(ObjectType type) {
+        return type == ObjectType::kString;
+    }
+    static void* operator new(size_t size);
+    static void operator delete(void* ptr);
+
+    // С кавычками и escape-последовательностями, как литерал
+    virtual void PrintTo(std::string* out) override;
+    size_t ByteSize() const override;
+    const std::string& GetValue() const {
+        return value_;
+    }
+
+private:
+    std::string value_;
+};
+
+// Строковый порт вывода: накапливает текст в одном буфере, который растёт
+// с запасом, поэтому серия записей линейна по суммарной длине
+class StringPortNode : public Object {
+public:
+    StringPortNode();
+    static bool HasType(ObjectType type) {
+        return type == ObjectType::kStringPort;
+    }
+
+    virtual void PrintTo(std::string* out) override;
+    size_t ByteSize() const override;
+    std::string& Buffer() {
+        return buffer_;
+    }
+
+private:
+    std::string buffer_;
+};
+
+// Однородный числовой вектор: элементы хранятся неупакованными в плотном
+// массиве, и массовые операции работают с ним напрямую, без Value
+template <class T, ObjectType kType>
+class NumericVectorNode : public Object {
+public:
+    typedef T Element;
+
+    explicit NumericVectorNode(std::vector<T> elements)
+        : Object(kType), elements_(std::move(elements)) {
+    }
+    static bool HasType(ObjectType type) {
+        return type == kType;
+    }
+
+    virtual void PrintTo(std::string* out) override;
+    size_t ByteSize() const override {
+        return sizeof(*this) + elements_.capacity() * sizeof(T);
+    }
+    size_t Size() const {
+        return elements_.size();
+    }
+    T* Data() {
+        return elements_.data();
+    }
+    std::vector<T>& Elements() {
+        return elements_;
+    }
+
+private:
+    std::vector<T> elements_;
+};
+
+typedef NumericVectorNode<int64_t, ObjectType::kS64Vector> S64VectorNode;
+typedef NumericVectorNode<double, ObjectType::kF64Vector> F64VectorNode;
+
+template <>
+void S64VectorNode::PrintTo(std::string* out);
+template <>
+void F64VectorNode::PrintTo(std::string* out);
+////
+
+//// Таблица интернированных символов
+// Символы живут до конца программы и общие для всех потоков
+SymbolNode* Intern(std::string_view name);
+// Символ по номеру из GetId
+SymbolNode* SymbolById(SymbolId id);
 ////
 
 //// Доп assert'ы для парсера
-inline bool IsNumber(const std::shared_ptr<Object>& obj) {
-    if (auto new_num = std::dynamic_pointer_cast<NumberNode>(obj)) {
-        return true;
-    }
-    return false;
+inline NumberNode* AsNumber(const Value& obj) {
+    return As<NumberNode>(obj.GetObject());
 }
-inline bool IsCell(const std::shared_ptr<Object>& obj) {
-    if (auto new_cell = std::dynamic_pointer_cast<CellNode>(obj)) {
-        return true;
-    }
-    return false;
+inline FlonumNode* AsFlonum(const Value& obj) {
+    return As<FlonumNode>(obj.GetObject());
 }
-inline bool IsSymbol(const std::shared_ptr<Object>& obj) {
-    if (auto new_sym = std::dynamic_pointer_cast<SymbolNode>(obj)) {
-        return true;
-    }
-    return false;
+inline CellNode* AsCell(const Value& obj) {
+    return As<CellNode>(obj.GetObject());
+}
+inline SymbolNode* AsSymbol(const Value& obj) {
+    return As<SymbolNode>(obj.GetObject());
+}
+inline VectorNode* AsVector(const Value& obj) {
+    return As<VectorNode>(obj.GetObject());
+}
+inline HashTableNode* AsHashTable(const Value& obj) {
+    return As<HashTableNode>(obj.GetObject());
+}
+inline StringNode* AsString(const Value& obj) {
+    return As<StringNode>(obj.GetObject());
 }
 
-inline auto AsNumber(const std::shared_ptr<Object>& obj) {
-    return std::dynamic_pointer_cast<NumberNode>(obj);
+inline bool IsNumber(const Value& obj) {
+    return obj.IsFixnum() || AsNumber(obj) || AsFlonum(obj);
+}
+inline bool IsCell(const Value& obj) {
+    return AsCell(obj);
+}
+inline bool IsSymbol(const Value& obj) {
+    return AsSymbol(obj);
 }
 
-inline auto AsCell(const std::shared_ptr<Object>& obj) {
-    return std::dynamic_pointer_cast<CellNode>(obj);
+inline Value MakeInteger(int64_t value) {
+    if (Value::FitsFixnum(value)) {
+        return Value::Fixnum(value);
+    }
+    return New<NumberNode>(BigInt(value));
+}
+inline Value MakeFlonum(double value) {
+    return New<FlonumNode>(value);
 }
-inline auto AsSymbol(const std::shared_ptr<Object>& obj) {
-    return std::dynamic_pointer_cast<SymbolNode>(obj);
+// Результат длинной арифметики: в диапазоне fixnum снова становится fixnum
+inline Value MakeInteger(BigInt value) {
+    if (value.FitsInt64()) {
+        return MakeInteger(value.ToInt64());
+    }
+    return New<NumberNode>(std::move(value));
 }
 ////
 
 //// Парсинг
-std::shared_ptr<Object> Read(Tokenizer* tokenizer);
-std::shared_ptr<Object> ReadList(Tokenizer* tokenizer);
-////
\ No newline at end of file
+Value Read(Tokenizer* tokenizer);
+Value ReadList(Tokenizer* tokenizer);
+////
@@ -0,0 +1,129 @@
+#include "printer.h"
+#include "parser.h"
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <stdexcept>
+#include <unistd.h>
+
+//// OutputBuffer
+OutputBuffer::OutputBuffer(int fd) : fd_(fd) { buffer_.reserve(kChunkSize); }
+
+// Ошибку записи здесь уже некому сообщить
+OutputBuffer::~OutputBuffer() {
+  try {
+    Flush();
+  } catch (const std::exception &) {
+  }
+}
+
+void OutputBuffer::Flush() {
+  size_t done = 0;
+  while (done < buffer_.size()) {
+    auto written = write(fd_, buffer_.data() + done, buffer_.size() - done);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      buffer_.clear();
+      throw std::runtime_error(std::string("Output error: ") +
+                               std::strerror(errno));
+    }
+    done += written;
+  }
+  flushed_ += buffer_.size();
+  buffer_.clear();
+}
+////
+
+//// Печать
+namespace {
+
+// Отложенная работа: напечатать значение, продолжить список с его хвоста
+// или вектор с индекса
+struct Task {
+  enum Kind { kValue, kListRest, kVectorRest };
+  Kind kind;
+  Value value;
+  size_t index;
+};
+
+void PrintAtom(const Value &value, std::string *out, PrintMode mode) {
+  if (value.IsFixnum()) {
+    char buffer[24];
+    auto end =
+        std::to_chars(buffer, buffer + sizeof(buffer), value.GetFixnum()).ptr;
+    out->append(buffer, end);
+  } else if (value.IsBool()) {
+    out->append(value.GetBool() ? "#t" : "#f");
+  } else if (!value) {
+    out->append("()");
+  } else if (auto string = AsString(value); string && mode == PrintMode::kDisplay) {
+    out->append(string->GetValue());
+  } else {
+    value.GetObject()->PrintTo(out);
+  }
+}
+
+void Print(const Value &value, std::string *out, PrintMode mode,
+           OutputBuffer *sink) {
+  std::vector<Task> stack{{Task::kValue, value, 0}};
+  while (!stack.empty()) {
+    auto task = stack.back();
+    stack.pop_back();
+    if (task.kind == Task::kListRest) {
+      if (auto cell = AsCell(task.value)) {
+        out->push_back(' ');
+        stack.push_back({Task::kListRest, cell->GetSecond(), 0});
+        stack.push_back({Task::kValue, cell->GetFirst(), 0});
+      } else if (task.value) {
+        // Хвост не список: точечная пара, после значения - закрывающая скобка
+        out->append(" . ");
+        stack.push_back({Task::kListRest, Value(), 0});
+        stack.push_back({Task::kValue, task.value, 0});
+      } else {
+        out->push_back(')');
+      }
+    } else if (task.kind == Task::kVectorRest) {
+      auto vector = AsVector(task.value);
+      if (task.index < vector->Size()) {
+        if (task.index) {
+          out->push_back(' ');
+        }
+        stack.push_back({Task::kVectorRest, task.value, task.index + 1});
+        stack.push_back({Task::kValue, vector->Get(task.index), 0});
+      } else {
+        out->push_back(')');
+      }
+    } else if (auto cell = AsCell(task.value)) {
+      out->push_back('(');
+      stack.push_back({Task::kListRest, cell->GetSecond(), 0});
+      stack.push_back({Task::kValue, cell->GetFirst(), 0});
+    } else if (AsVector(task.value)) {
+      out->append("#(");
+      stack.push_back({Task::kVectorRest, task.value, 0});
+    } else {
+      PrintAtom(task.value, out, mode);
+    }
+    if (sink) {
+      sink->MaybeFlush();
+    }
+  }
+}
+
+} // namespace
+
+void PrintTo(const Value &value, std::string *out, PrintMode mode) {
+  Print(value, out, mode, nullptr);
+}
+
+void PrintTo(const Value &value, OutputBuffer *out, PrintMode mode) {
+  Print(value, out->Buffer(), mode, out);
+}
+
+std::string Print(const Value &value) {
+  std::string out;
+  PrintTo(value, &out);
+  return out;
+}
+////
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "value.h"
+#include <string>
+#include <vector>
+
+//// Вывод в файловый дескриптор
+// Текст копится в буфере и уходит в fd блоками не меньше kChunkSize одним
+// write, без промежуточного буфера stdio
+class OutputBuffer {
+public:
+    static const size_t kChunkSize = 1 << 16;
+
+    explicit OutputBuffer(int fd);
+    ~OutputBuffer();
+
+    OutputBuffer(const OutputBuffer&) = delete;
+    OutputBuffer& operator=(const OutputBuffer&) = delete;
+
+    std::string* Buffer() {
+        return &buffer_;
+    }
+    // Сколько байт записано за всё время, включая уже сброшенные
+    size_t Written() const {
+        return flushed_ + buffer_.size();
+    }
+    // Сбрасывает буфер, только если в нём набрался блок
+    void MaybeFlush() {
+        if (buffer_.size() >= kChunkSize) {
+            Flush();
+        }
+    }
+    // std::runtime_error, если запись не удалась
+    void Flush();
+
+private:
+    std::string buffer_;
+    int fd_;
+    size_t flushed_ = 0;
+};
+////
+
+//// Печать значений
+// Пары и векторы обходятся явным стеком, а не рекурсией, поэтому глубина
+// вложенности ограничена только памятью. kWrite печатает строки литералами,
+// как REPL, kDisplay - без кавычек и escape-последовательностей
+enum class PrintMode { kWrite, kDisplay };
+
+void PrintTo(const Value& value, std::string* out, PrintMode mode = PrintMode::kWrite);
+// Длинный вывод сбрасывается в fd по ходу печати
+void PrintTo(const Value& value, OutputBuffer* out, PrintMode mode = PrintMode::kWrite);
+std::string Print(const Value& value);
+////
@@ -0,0 +1,215 @@
+#include "profiler.h"
+#include "compiler.h"
+#include "scheme.h"
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <iostream>
+
+namespace {
+
+uint64_t Nanoseconds(Profiler::Clock::duration duration) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(duration)
+      .count();
+}
+
+double Milliseconds(uint64_t ns) { return ns / 1e6; }
+
+} // namespace
+
+//// Profiler
+Profiler *Profiler::Install(Profiler *profiler) {
+  auto previous = current_;
+  current_ = profiler;
+  return previous;
+}
+
+Profiler::Profiler() { tree_.push_back(TreeNode{0, kNone, kNone, kNone, 0}); }
+
+void Profiler::Enter(const LambdaFunc *lambda) {
+  auto &stats = Enter(reinterpret_cast<Key>(lambda->code_.get()));
+  if (!stats.code) {
+    stats.code = lambda->code_;
+  }
+}
+
+void Profiler::Enter(const Function *function) {
+  Enter(reinterpret_cast<Key>(function) | 1);
+}
+
+Profiler::Stats &Profiler::Enter(Key key) {
+  auto &stats = stats_[key];
+  ++stats.calls;
+  ++stats.active;
+  auto parent = stack_.empty() ? 0 : stack_.back().node;
+  stack_.push_back(Activation{&stats, Child(parent, key), Clock::now(), 0});
+  return stats;
+}
+
+void Profiler::Exit() {
+  if (stack_.empty()) {
+    return;
+  }
+  auto &activation = stack_.back();
+  auto elapsed = Nanoseconds(Clock::now() - activation.start);
+  auto self = elapsed - std::min(elapsed, activation.children_ns);
+  auto &stats = *activation.stats;
+  stats.self_ns += self;
+  if (--stats.active == 0) {
+    stats.total_ns += elapsed;
+  }
+  tree_[activation.node].self_ns += self;
+  stack_.pop_back();
+  if (!stack_.empty()) {
+    stack_.back().children_ns += elapsed;
+  }
+}
+
+void Profiler::UnwindTo(size_t depth) {
+  while (stack_.size() > depth) {
+    Exit();
+  }
+}
+
+// Прямая рекурсия сворачивается в один узел: иначе глубокая рекурсия дала
+// бы стеки длиной в глубину
+uint32_t Profiler::Child(uint32_t parent, Key key) {
+  if (parent != 0 && tree_[parent].key == key) {
+    return parent;
+  }
+  for (auto child = tree_[parent].first_child; child != kNone;
+       child = tree_[child].next_sibling) {
+    if (tree_[child].key == key) {
+      return child;
+    }
+  }
+  auto index = static_cast<uint32_t>(tree_.size());
+  tree_.push_back(
+      TreeNode{key, parent, kNone, tree_[parent].first_child, 0});
+  tree_[parent].first_child = index;
+  return index;
+}
+
+// Встроенная функция может быть доступна под несколькими именами: берётся
+// наименьшее, чтобы отчёт не зависел от порядка таблицы
+std::unordered_map<Profiler::Key, std::string>
+Profiler::Names(Scope *globals) const {
+  std::unordered_map<Key, std::string> names;
+  for (auto &[id, value] : globals->scope_) {
+    auto fn = As<Function>(value.GetObject());
+    if (!fn || As<LambdaFunc>(fn)) {
+      continue;
+    }
+    auto key = reinterpret_cast<Key>(fn) | 1;
+    if (!stats_.count(key)) {
+      continue;
+    }
+    auto &name = SymbolById(id)->GetName();
+    auto it = names.find(key);
+    if (it == names.end() || name < it->second) {
+      names[key] = name;
+    }
+  }
+  for (auto &[key, stats] : stats_) {
+    if (stats.code) {
+      auto symbol = stats.code->name;
+      names[key] = symbol ? symbol->GetName() : "lambda";
+    } else if (!names.count(key)) {
+      names[key] = "builtin";
+    }
+  }
+  return names;
+}
+
+std::string Profiler::Report(Scope *globals) const {
+  auto names = Names(globals);
+  std::vector<std::pair<const std::string *, const Stats *>> rows;
+  uint64_t total_ns = 0;
+  uint64_t calls = 0;
+  for (auto &[key, stats] : stats_) {
+    rows.emplace_back(&names[key], &stats);
+    total_ns += stats.self_ns;
+    calls += stats.calls;
+  }
+  std::sort(rows.begin(), rows.end(), [](auto &lhs, auto &rhs) {
+    if (lhs.second->self_ns != rhs.second->self_ns) {
+      return lhs.second->self_ns > rhs.second->self_ns;
+    }
+    return *lhs.first < *rhs.first;
+  });
+
+  std::string out;
+  char line[128];
+  std::snprintf(line, sizeof(line),
+                "profile: %.3f ms in %" PRIu64 " calls\n%12s %12s %7s %12s  %s\n",
+                Milliseconds(total_ns), calls, "calls", "self ms", "self%",
+                "total ms", "function");
+  out += line;
+  for (auto &[name, stats] : rows) {
+    std::snprintf(line, sizeof(line), "%12" PRIu64 " %12.3f %6.1f%% %12.3f  ",
+                  stats->calls, Milliseconds(stats->self_ns),
+                  total_ns ? 100.0 * stats->self_ns / total_ns : 0.0,
+                  Milliseconds(stats->total_ns));
+    out += line;
+    out += *name;
+    out += '\n';
+  }
+  return out;
+}
+
+std::string Profiler::Collapsed(Scope *globals) const {
+  auto names = Names(globals);
+  std::string out;
+  std::string path;
+  // Обход в глубину без рекурсии: узел и длина пути до его родителя
+  std::vector<std::pair<uint32_t, size_t>> pending;
+  for (auto child = tree_[0].first_child; child != kNone;
+       child = tree_[child].next_sibling) {
+    pending.emplace_back(child, 0);
+  }
+  while (!pending.empty()) {
+    auto [index, prefix] = pending.back();
+    pending.pop_back();
+    auto &node = tree_[index];
+    path.resize(prefix);
+    if (prefix) {
+      path += ';';
+    }
+    path += names[node.key];
+    if (node.self_ns) {
+      out += path;
+      out += ' ';
+      out += std::to_string(node.self_ns);
+      out += '\n';
+    }
+    for (auto child = node.first_child; child != kNone;
+         child = tree_[child].next_sibling) {
+      pending.emplace_back(child, path.size());
+    }
+  }
+  return out;
+}
+////
+
+//// ProfileSession
+ProfileSession::ProfileSession() {
+  if (!Profiler::Current()) {
+    profiler_ = std::make_unique<Profiler>();
+    Profiler::Install(profiler_.get());
+  }
+}
+
+ProfileSession::~ProfileSession() {
+  if (profiler_) {
+    Profiler::Install(nullptr);
+  }
+}
+
+void ProfileSession::Finish(Scope *globals) {
+  if (profiler_) {
+    Profiler::Install(nullptr);
+    std::cerr << profiler_->Report(globals);
+    profiler_.reset();
+  }
+}
+////
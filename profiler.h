@@ -0,0 +1,112 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class Function;
+class LambdaFunc;
+class Scope;
+struct LambdaCode;
+
+//// Профилировщик вызовов
+// Считает для каждой лямбды (по её LambdaCode, имя берётся из define) и
+// каждой встроенной функции число вызовов, собственное время и время вместе
+// с вызванными. Заодно строит дерево вызовов для свёрнутых стеков в формате
+// flamegraph.pl. Профилировщик привязан к потоку: места вызовов проверяют
+// Current(), и без профилирования это единственная лишняя проверка
+class Profiler {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    static Profiler* Current() {
+        return current_;
+    }
+    // Делает profiler текущим для потока (nullptr выключает), возвращает прежний
+    static Profiler* Install(Profiler* profiler);
+
+    Profiler();
+
+    void Enter(const LambdaFunc* lambda);
+    void Enter(const Function* function);
+    // Без парного Enter (профилирование включили посреди вызова) ничего не делает
+    void Exit();
+
+    // Глубина стека вызовов: после исключения он срезается до сохранённой
+    size_t Depth() const {
+        return stack_.size();
+    }
+    void UnwindTo(size_t depth);
+
+    // Таблица, отсортированная по собственному времени. Имена встроенных
+    // функций ищутся среди глобальных переменных globals
+    std::string Report(Scope* globals) const;
+    // Строки "f;g;h <наносекунды собственного времени>" для flamegraph.pl
+    std::string Collapsed(Scope* globals) const;
+
+private:
+    // Адрес LambdaCode или встроенной функции; у функций взведён младший бит
+    typedef uintptr_t Key;
+
+    struct Stats {
+        uint64_t calls = 0;
+        uint64_t self_ns = 0;
+        uint64_t total_ns = 0;
+        // Активации на стеке: у рекурсии полное время считает только внешняя
+        uint32_t active = 0;
+        // Держит код лямбды, чтобы её адрес не достался другой лямбде
+        std::shared_ptr<LambdaCode> code;
+    };
+
+    struct TreeNode {
+        Key key;
+        uint32_t parent;
+        uint32_t first_child;
+        uint32_t next_sibling;
+        uint64_t self_ns;
+    };
+
+    struct Activation {
+        Stats* stats;
+        uint32_t node;
+        Clock::time_point start;
+        uint64_t children_ns;
+    };
+
+    static const uint32_t kNone = UINT32_MAX;
+
+    Stats& Enter(Key key);
+    uint32_t Child(uint32_t parent, Key key);
+    std::unordered_map<Key, std::string> Names(Scope* globals) const;
+
+    static inline thread_local Profiler* current_ = nullptr;
+
+    std::unordered_map<Key, Stats> stats_;
+    // tree_[0] - корень без функции
+    std::vector<TreeNode> tree_;
+    std::vector<Activation> stack_;
+};
+////
+
+//// Профилирование одного выражения: (profile expr)
+// Если поток ещё не профилируется, на время выражения заводится свой
+// профилировщик, и Finish печатает его отчёт в stderr. Внутри идущего
+// профилирования (вложенный profile, флаг --profile) вызовы попадают в общий
+// отчёт. При исключении отчёт не печатается
+class ProfileSession {
+public:
+    ProfileSession();
+    ~ProfileSession();
+
+    ProfileSession(const ProfileSession&) = delete;
+    ProfileSession& operator=(const ProfileSession&) = delete;
+
+    void Finish(Scope* globals);
+
+private:
+    std::unique_ptr<Profiler> profiler_;
+};
+////
@@ -0,0 +1,49 @@
+#include "runtime_stats.h"
+#include "gc.h"
+
+RuntimeStats RuntimeStats::Current() {
+  auto &heap = Heap::Current();
+  RuntimeStats stats;
+  stats.counters = RuntimeCounters::Current();
+  for (size_t type = 0; type < kObjectTypeCount; ++type) {
+    stats.allocated[type] = heap.Allocations(static_cast<ObjectType>(type));
+  }
+  stats.collections = heap.Epoch();
+  stats.live_objects = heap.LiveObjects();
+  stats.heap_bytes = heap.Bytes();
+  return stats;
+}
+
+const char *ObjectTypeName(ObjectType type) {
+  switch (type) {
+  case ObjectType::kNumber:
+    return "number";
+  case ObjectType::kFlonum:
+    return "flonum";
+  case ObjectType::kSymbol:
+    return "symbol";
+  case ObjectType::kCell:
+    return "pair";
+  case ObjectType::kVector:
+    return "vector";
+  case ObjectType::kS64Vector:
+    return "s64vector";
+  case ObjectType::kF64Vector:
+    return "f64vector";
+  case ObjectType::kHashTable:
+    return "hash-table";
+  case ObjectType::kString:
+    return "string";
+  case ObjectType::kStringPort:
+    return "string-port";
+  case ObjectType::kBuiltin:
+    return "builtin";
+  case ObjectType::kLambda:
+    return "lambda";
+  case ObjectType::kSyntax:
+    return "syntax";
+  case ObjectType::kFrame:
+    return "frame";
+  }
+  return "object";
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "value.h"
+#include <cstdint>
+
+//// Счётчики выполнения потока
+// У каждого потока свои счётчики, как и своя куча: увеличение - обычная
+// запись в память потока, без атомарных операций и общих строк кэша
+struct RuntimeCounters {
+    // Выражения верхнего уровня (Scheme::EvaluateExpr)
+    uint64_t evaluations = 0;
+    // Вызовы лямбд, включая хвостовые, и встроенных функций
+    uint64_t lambda_calls = 0;
+    uint64_t builtin_calls = 0;
+    // Поиски глобальной переменной в таблице Scope. Место обращения
+    // кэширует найденную ячейку (GlobalSlot), так что это поиски на
+    // первом выполнении, а не каждое чтение переменной
+    uint64_t global_lookups = 0;
+    uint64_t global_misses = 0;
+    // Наибольшая вложенность вызовов лямбд
+    uint64_t max_call_depth = 0;
+
+    static RuntimeCounters& Current() {
+        thread_local RuntimeCounters counters;
+        return counters;
+    }
+
+    void NoteCallDepth(uint64_t depth) {
+        if (depth > max_call_depth) {
+            max_call_depth = depth;
+        }
+    }
+};
+////
+
+//// Снимок статистики потока: счётчики и состояние кучи
+struct RuntimeStats {
+    RuntimeCounters counters;
+    // Созданные в куче за всё время объекты по видам (символы в ней не живут)
+    uint64_t allocated[kObjectTypeCount] = {};
+    uint64_t collections = 0;
+    // Объекты в куче и их память: с созданием растут, при сборке
+    // уменьшаются на освобождённое (Heap::LiveObjects, Heap::Bytes)
+    uint64_t live_objects = 0;
+    uint64_t heap_bytes = 0;
+
+    static RuntimeStats Current();
+};
+
+// Имя вида объекта в отчётах: "pair", "lambda", ...
+const char* ObjectTypeName(ObjectType type);
+////
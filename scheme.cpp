@@ -1,60 +1,236 @@
 #pragma once
 
 #include "scheme.h"
+#include "compiler.h"
+#include "image.h"
+#include "mapped_file.h"
+#include "profiler.h"
+#include "runtime_stats.h"
+#include "vm.h"
+#include <algorithm>
+#include <fstream>
 #include <sstream>
 
-std::shared_ptr<Object> Scope::Lookup(const std::string& name) {
-    auto it = scope_.find(name);
+Value* Scope::Find(SymbolId id) {
+    auto& counters = RuntimeCounters::Current();
+    ++counters.global_lookups;
+    auto it = scope_.find(id);
     if (it == scope_.end()) {
-        throw NameError("Naming error");
-    }
-    return it->second;
-}
-Scheme::Scheme() : global_scope_(std::make_shared<Scope>()) {
-    global_scope_->scope_["+"] = std::make_shared<Plus>();
-    global_scope_->scope_["-"] = std::make_shared<Minus>();
-    global_scope_->scope_["/"] = std::make_shared<Divide>();
-    global_scope_->scope_["*"] = std::make_shared<Multiply>();
-    global_scope_->scope_["if"] = std::make_shared<If>();
-    global_scope_->scope_["'"] = std::make_shared<Quote>();
-    global_scope_->scope_["quote"] = std::make_shared<Quote>();
-    global_scope_->scope_["#t"] = std::make_shared<Boolean>(true);
-    global_scope_->scope_["#f"] = std::make_shared<Boolean>(false);
-    global_scope_->scope_["="] = std::make_shared<Equal>();
-    global_scope_->scope_[">"] = std::make_shared<Greater>();
-    global_scope_->scope_[">="] = std::make_shared<GreaterOrEqual>();
-    global_scope_->scope_["<"] = std::make_shared<Less>();
-    global_scope_->scope_["<="] = std::make_shared<LessOrEqual>();
-    global_scope_->scope_["abs"] = std::make_shared<Abs>();
-    global_scope_->scope_["min"] = std::make_shared<Min>();
-    global_scope_->scope_["max"] = std::make_shared<Max>();
-    global_scope_->scope_["number?"] = std::make_shared<NumberCheck>();
-    global_scope_->scope_["pair?"] = std::make_shared<PairCheck>();
-    global_scope_->scope_["null?"] = std::make_shared<NullCheck>();
-    global_scope_->scope_["list?"] = std::make_shared<ListCheck>();
-    global_scope_->scope_["symbol?"] = std::make_shared<SymbolCheck>();
-    global_scope_->scope_["cons"] = std::make_shared<Cons>();
-    global_scope_->scope_["car"] = std::make_shared<Car>();
-    global_scope_->scope_["cdr"] = std::make_shared<Cdr>();
-    global_scope_->scope_["define"] = std::make_shared<Define>();
-    global_scope_->scope_["set-car!"] = std::make_shared<SetCar>();
-    global_scope_->scope_["set-cdr!"] = std::make_shared<SetCdr>();
-    global_scope_->scope_["list"] = std::make_shared<ListCmd>();
-    global_scope_->scope_["list-ref"] = std::make_shared<ListRef>();
-    global_scope_->scope_["list-tail"] = std::make_shared<ListTail>();
-    global_scope_->scope_["boolean?"] = std::make_shared<BooleanCheck>();
-    global_scope_->scope_["not"] = std::make_shared<Not>();
-    global_scope_->scope_["and"] = std::make_shared<And>();
-    global_scope_->scope_["or"] = std::make_shared<Or>();
-    global_scope_->scope_["set!"] = std::make_shared<Set>();
-    global_scope_->scope_["lambda"] = std::make_shared<Lambda>();
+        ++counters.global_misses;
+        return nullptr;
+    }
+    return &it->second;
+}
+Scheme::Scheme()
+    : global_scope_(std::make_shared<Scope>()), vm_(std::make_unique<VirtualMachine>()) {
+    Heap::Current().AddRoots(this);
+    global_scope_->scope_[Intern("+")->GetId()] = New<Plus>();
+    global_scope_->scope_[Intern("-")->GetId()] = New<Minus>();
+    global_scope_->scope_[Intern("/")->GetId()] = New<Divide>();
+    global_scope_->scope_[Intern("*")->GetId()] = New<Multiply>();
+    global_scope_->scope_[Intern("quotient")->GetId()] = New<Quotient>();
+    global_scope_->scope_[Intern("remainder")->GetId()] = New<Remainder>();
+    global_scope_->scope_[Intern("exact->inexact")->GetId()] = New<ExactToInexact>();
+    global_scope_->scope_[Intern("if")->GetId()] = New<If>();
+    global_scope_->scope_[Intern("\'")->GetId()] = New<Quote>();
+    global_scope_->scope_[Intern("quote")->GetId()] = New<Quote>();
+    global_scope_->scope_[Intern("#t")->GetId()] = Value::Bool(true);
+    global_scope_->scope_[Intern("#f")->GetId()] = Value::Bool(false);
+    global_scope_->scope_[Intern("=")->GetId()] = New<Equal>();
+    global_scope_->scope_[Intern(">")->GetId()] = New<Greater>();
+    global_scope_->scope_[Intern(">=")->GetId()] = New<GreaterOrEqual>();
+    global_scope_->scope_[Intern("<")->GetId()] = New<Less>();
+    global_scope_->scope_[Intern("<=")->GetId()] = New<LessOrEqual>();
+    global_scope_->scope_[Intern("abs")->GetId()] = New<Abs>();
+    global_scope_->scope_[Intern("min")->GetId()] = New<Min>();
+    global_scope_->scope_[Intern("max")->GetId()] = New<Max>();
+    global_scope_->scope_[Intern("number?")->GetId()] = New<NumberCheck>();
+    global_scope_->scope_[Intern("pair?")->GetId()] = New<PairCheck>();
+    global_scope_->scope_[Intern("null?")->GetId()] = New<NullCheck>();
+    global_scope_->scope_[Intern("list?")->GetId()] = New<ListCheck>();
+    global_scope_->scope_[Intern("symbol?")->GetId()] = New<SymbolCheck>();
+    global_scope_->scope_[Intern("cons")->GetId()] = New<Cons>();
+    global_scope_->scope_[Intern("car")->GetId()] = New<Car>();
+    global_scope_->scope_[Intern("cdr")->GetId()] = New<Cdr>();
+    global_scope_->scope_[Intern("define")->GetId()] = New<Define>();
+    global_scope_->scope_[Intern("set-car!")->GetId()] = New<SetCar>();
+    global_scope_->scope_[Intern("set-cdr!")->GetId()] = New<SetCdr>();
+    global_scope_->scope_[Intern("list")->GetId()] = New<ListCmd>();
+    global_scope_->scope_[Intern("list-ref")->GetId()] = New<ListRef>();
+    global_scope_->scope_[Intern("list-tail")->GetId()] = New<ListTail>();
+    global_scope_->scope_[Intern("make-vector")->GetId()] = New<MakeVector>();
+    global_scope_->scope_[Intern("vector")->GetId()] = New<VectorCmd>();
+    global_scope_->scope_[Intern("vector?")->GetId()] = New<VectorCheck>();
+    global_scope_->scope_[Intern("vector-length")->GetId()] = New<VectorLength>();
+    global_scope_->scope_[Intern("vector-ref")->GetId()] = New<VectorRef>();
+    global_scope_->scope_[Intern("vector-set!")->GetId()] = New<VectorSet>();
+    global_scope_->scope_[Intern("vector->list")->GetId()] = New<VectorToList>();
+    global_scope_->scope_[Intern("list->vector")->GetId()] = New<ListToVector>();
+    global_scope_->scope_[Intern("make-s64vector")->GetId()] = New<MakeNumericVector<S64VectorNode>>();
+    global_scope_->scope_[Intern("s64vector")->GetId()] = New<NumericVectorCmd<S64VectorNode>>();
+    global_scope_->scope_[Intern("s64vector?")->GetId()] = New<NumericVectorCheck<S64VectorNode>>();
+    global_scope_->scope_[Intern("s64vector-length")->GetId()] = New<NumericVectorLength<S64VectorNode>>();
+    global_scope_->scope_[Intern("s64vector-ref")->GetId()] = New<NumericVectorRef<S64VectorNode>>();
+    global_scope_->scope_[Intern("s64vector-set!")->GetId()] = New<NumericVectorSet<S64VectorNode>>();
+    global_scope_->scope_[Intern("s64vector->list")->GetId()] = New<NumericVectorToList<S64VectorNode>>();
+    global_scope_->scope_[Intern("list->s64vector")->GetId()] = New<ListToNumericVector<S64VectorNode>>();
+    global_scope_->scope_[Intern("make-f64vector")->GetId()] = New<MakeNumericVector<F64VectorNode>>();
+    global_scope_->scope_[Intern("f64vector")->GetId()] = New<NumericVectorCmd<F64VectorNode>>();
+    global_scope_->scope_[Intern("f64vector?")->GetId()] = New<NumericVectorCheck<F64VectorNode>>();
+    global_scope_->scope_[Intern("f64vector-length")->GetId()] = New<NumericVectorLength<F64VectorNode>>();
+    global_scope_->scope_[Intern("f64vector-ref")->GetId()] = New<NumericVectorRef<F64VectorNode>>();
+    global_scope_->scope_[Intern("f64vector-set!")->GetId()] = New<NumericVectorSet<F64VectorNode>>();
+    global_scope_->scope_[Intern("f64vector->list")->GetId()] = New<NumericVectorToList<F64VectorNode>>();
+    global_scope_->scope_[Intern("list->f64vector")->GetId()] = New<ListToNumericVector<F64VectorNode>>();
+    global_scope_->scope_[Intern("uvector-add")->GetId()] = New<NumericVectorAdd>();
+    global_scope_->scope_[Intern("uvector-mul")->GetId()] = New<NumericVectorMul>();
+    global_scope_->scope_[Intern("uvector-dot")->GetId()] = New<NumericVectorDot>();
+    global_scope_->scope_[Intern("uvector-sum")->GetId()] = New<NumericVectorSum>();
+    global_scope_->scope_[Intern("uvector-min")->GetId()] = New<NumericVectorMin>();
+    global_scope_->scope_[Intern("uvector-max")->GetId()] = New<NumericVectorMax>();
+    global_scope_->scope_[Intern("uvector-axpy!")->GetId()] = New<NumericVectorAxpy>();
+    global_scope_->scope_[Intern("make-hash-table")->GetId()] = New<MakeHashTable>();
+    global_scope_->scope_[Intern("hash-table?")->GetId()] = New<HashTableCheck>();
+    global_scope_->scope_[Intern("hash-table-ref")->GetId()] = New<HashTableRef>();
+    global_scope_->scope_[Intern("hash-table-ref/default")->GetId()] = New<HashTableRefDefault>();
+    global_scope_->scope_[Intern("hash-table-set!")->GetId()] = New<HashTableSet>();
+    global_scope_->scope_[Intern("hash-table-delete!")->GetId()] = New<HashTableDelete>();
+    global_scope_->scope_[Intern("hash-table-contains?")->GetId()] = New<HashTableContains>();
+    global_scope_->scope_[Intern("hash-table-count")->GetId()] = New<HashTableCount>();
+    global_scope_->scope_[Intern("hash-table-keys")->GetId()] = New<HashTableKeys>();
+    global_scope_->scope_[Intern("hash-table-values")->GetId()] = New<HashTableValues>();
+    global_scope_->scope_[Intern("hash-table->alist")->GetId()] = New<HashTableToAlist>();
+    global_scope_->scope_[Intern("hash-table-walk")->GetId()] = New<HashTableWalk>();
+    global_scope_->scope_[Intern("string?")->GetId()] = New<StringCheck>();
+    global_scope_->scope_[Intern("string-length")->GetId()] = New<StringLength>();
+    global_scope_->scope_[Intern("string-append")->GetId()] = New<StringAppend>();
+    global_scope_->scope_[Intern("substring")->GetId()] = New<Substring>();
+    global_scope_->scope_[Intern("string=?")->GetId()] = New<StringEqual>();
+    global_scope_->scope_[Intern("string->symbol")->GetId()] = New<StringToSymbol>();
+    global_scope_->scope_[Intern("symbol->string")->GetId()] = New<SymbolToString>();
+    global_scope_->scope_[Intern("number->string")->GetId()] = New<NumberToString>();
+    global_scope_->scope_[Intern("open-output-string")->GetId()] = New<OpenOutputString>();
+    global_scope_->scope_[Intern("get-output-string")->GetId()] = New<GetOutputString>();
+    global_scope_->scope_[Intern("write-string")->GetId()] = New<WriteString>();
+    global_scope_->scope_[Intern("display")->GetId()] = New<Display>();
+    global_scope_->scope_[Intern("write")->GetId()] = New<Write>();
+    global_scope_->scope_[Intern("newline")->GetId()] = New<Newline>();
+    global_scope_->scope_[Intern("boolean?")->GetId()] = New<BooleanCheck>();
+    global_scope_->scope_[Intern("not")->GetId()] = New<Not>();
+    global_scope_->scope_[Intern("eq?")->GetId()] = New<Eq>();
+    global_scope_->scope_[Intern("equal?")->GetId()] = New<StructEqual>();
+    global_scope_->scope_[Intern("and")->GetId()] = New<And>();
+    global_scope_->scope_[Intern("or")->GetId()] = New<Or>();
+    global_scope_->scope_[Intern("set!")->GetId()] = New<Set>();
+    global_scope_->scope_[Intern("lambda")->GetId()] = New<Lambda>();
+    global_scope_->scope_[Intern("profile")->GetId()] = New<Profile>();
+    global_scope_->scope_[Intern("runtime-stats")->GetId()] = New<RuntimeStatsCmd>();
+    global_scope_->scope_[Intern("save-image")->GetId()] = New<SaveImageCmd>(this);
+    initial_globals_ = global_scope_->scope_;
 }
 Scheme::~Scheme() {
+    auto& heap = Heap::Current();
+    heap.RemoveRoots(this);
     global_scope_->scope_.clear();
+    heap.Collect();
+}
+void Scheme::TraceRoots(Heap* heap) {
+    for (auto& [id, value] : global_scope_->scope_) {
+        heap->Mark(value);
+    }
+    for (auto& [id, value] : initial_globals_) {
+        heap->Mark(value);
+    }
+    vm_->Trace(heap);
+    for (auto node : running_) {
+        node->Trace(heap);
+    }
+}
+void Scheme::SetBackend(Backend backend) {
+    backend_ = backend;
+}
+void Scheme::Reset() {
+    // Ячейки встроенных переменных остаются на месте, удаляются только
+    // определения, которых не было после конструктора
+    auto& scope = global_scope_->scope_;
+    for (auto it = scope.begin(); it != scope.end();) {
+        auto initial = initial_globals_.find(it->first);
+        if (initial == initial_globals_.end()) {
+            it = scope.erase(it);
+        } else {
+            it->second = initial->second;
+            ++it;
+        }
+    }
+}
+void Scheme::SaveImage(const std::string& path) {
+    std::vector<SymbolId> changed;
+    for (auto& [id, value] : global_scope_->scope_) {
+        auto initial = initial_globals_.find(id);
+        if (initial == initial_globals_.end() || initial->second != value) {
+            changed.push_back(id);
+        }
+    }
+    // По именам, чтобы одно окружение давало один и тот же образ
+    std::sort(changed.begin(), changed.end(), [](SymbolId lhs, SymbolId rhs) {
+        return SymbolById(lhs)->GetName() < SymbolById(rhs)->GetName();
+    });
+    ImageWriter writer(initial_globals_);
+    for (auto id : changed) {
+        writer.AddGlobal(id, global_scope_->scope_[id]);
+    }
+    auto image = writer.Finish();
+    std::ofstream out(path, std::ios::binary);
+    out.write(image.data(), image.size());
+    out.close();
+    if (!out) {
+        throw RuntimeError("Can't write heap image " + path);
+    }
+}
+void Scheme::LoadImage(const std::string& path) {
+    MappedFile file(path);
+    ImageReader reader(file.View(), initial_globals_);
+    reader.Load(global_scope_.get());
+}
+Scope* Scheme::GetGlobals() {
+    return global_scope_.get();
+}
+RuntimeStats Scheme::GetRuntimeStats() const {
+    return RuntimeStats::Current();
 }
-std::shared_ptr<Object> Scheme::EvaluateExpr(std::shared_ptr<Object> in) {
+Value Scheme::EvaluateExpr(const Value& in) {
     if (in) {
-        return in->Evaluate(global_scope_);
+        ++RuntimeCounters::Current().evaluations;
+        Compiler compiler(global_scope_);
+        auto node = compiler.Compile(in);
+        // Константы выполняемого выражения живы, пока оно не завершится
+        auto& heap = Heap::Current();
+        auto* sp = heap.StackTop();
+        // Вызовы, прерванные исключением, закрываются в профилировщике
+        auto profiler = Profiler::Current();
+        auto profile_depth = profiler ? profiler->Depth() : 0;
+        running_.push_back(node.get());
+        try {
+            Value result;
+            if (backend_ == Backend::kBytecode) {
+                auto proto = BytecodeEmitter::CompileTopLevel(node.get());
+                result = vm_->Run(proto.get(), global_scope_.get());
+            } else {
+                Env env;
+                env.heap = &heap;
+                env.globals = global_scope_.get();
+                result = node->Execute(env);
+            }
+            running_.pop_back();
+            return result;
+        } catch (...) {
+            heap.PopTo(sp);
+            running_.pop_back();
+            if (profiler) {
+                profiler->UnwindTo(profile_depth);
+            }
+            throw;
+        }
     } else {
         throw RuntimeError("Null root node");
     }
@@ -1,38 +1,60 @@
 #pragma once
 
+#include "gc.h"
 #include "parser.h"
+#include "runtime_stats.h"
 #include <string>
 #include <unordered_map>
 #include <sstream>
 #include <iostream>
 
+// Ячейки таблицы не перемещаются и не удаляются, пока жив интерпретатор:
+// места обращения кэшируют их адреса (GlobalSlot)
 class Scope {
 public:
-    std::shared_ptr<Object> Lookup(const std::string& name);
+    // nullptr, если переменная не определена
+    Value* Find(SymbolId id);
 
-    std::unordered_map<std::string, std::shared_ptr<Object>> scope_;
+    std::unordered_map<SymbolId, Value> scope_;
     std::shared_ptr<Scope> outer_scope_;
 };
-class Scheme {
+class VirtualMachine;
+
+// kTree выполняет скомпилированное дерево, kBytecode - байткод на VirtualMachine
+enum class Backend { kTree, kBytecode };
+
+class CompiledNode;
+
+// Объекты, созданные интерпретатором, принадлежат куче его потока.
+// Значение, полученное из EvaluateExpr, живо до следующего вызова EvaluateExpr
+class Scheme : public Heap::RootSet {
 public:
     Scheme();
     ~Scheme();
-    std::shared_ptr<Object> EvaluateExpr(std::shared_ptr<Object> in);
+    Value EvaluateExpr(const Value& in);
+    void SetBackend(Backend backend);
+    // Возвращает глобальные переменные к начальным встроенным: определения
+    // прежних выражений пропадают, их объекты заберёт сборщик. Дешевле, чем
+    // новый Scheme, которому нужен свой стек VM. Значения и код, полученные
+    // до Reset, после него использовать нельзя (см. GlobalSlot)
+    void Reset();
+    // Образ глобальных переменных, отличных от начальных (image.h).
+    // Загрузка определяет сохранённые переменные поверх текущих
+    void SaveImage(const std::string& path);
+    void LoadImage(const std::string& path);
+    // Глобальные переменные: по ним профилировщик называет встроенные функции
+    Scope* GetGlobals();
+    // Счётчики и куча общие для всех интерпретаторов потока
+    RuntimeStats GetRuntimeStats() const;
+
+    void TraceRoots(Heap* heap) override;
 
 private:
     std::shared_ptr<Scope> global_scope_;
+    Backend backend_ = Backend::kTree;
+    std::unique_ptr<VirtualMachine> vm_;
+    // Выполняемые сейчас выражения верхнего уровня (вложенные при реентерабельности)
+    std::vector<CompiledNode*> running_;
+    // Глобальные переменные сразу после конструктора, для Reset
+    std::unordered_map<SymbolId, Value> initial_globals_;
 };
-
-inline void PrintTo(const std::shared_ptr<Object>& obj, std::ostream* out) {
-    if (!obj) {
-        *out << "()";
-        return;
-    }
-
-    obj->PrintTo(out);
-}
-inline std::string Print(const std::shared_ptr<Object>& obj) {
-    std::stringstream ss;
-    PrintTo(obj, &ss);
-    return ss.str();
-}
@@ -0,0 +1,281 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+#include <sys/resource.h>
+#include "scheme.h"
+
+//// Счётчик выделений: все operator new процесса
+// Объекты из пулов (пары, числа, строки) сюда не попадают, их считает
+// Heap::Allocations
+namespace {
+std::atomic<uint64_t> allocations{0};
+}  // namespace
+
+void* operator new(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (auto ptr = std::malloc(size ? size : 1)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    std::free(ptr);
+}
+////
+
+namespace {
+
+//// Замер
+// run выполняет порцию работы и возвращает число операций в ней.
+// Порции повторяются, пока не наберётся min_time; между порциями куча
+// может собрать мусор, и это время входит в замер
+struct Benchmark {
+    std::string name;
+    std::function<uint64_t()> run;
+};
+
+struct Result {
+    std::string name;
+    uint64_t iterations;
+    uint64_t ops;
+    double ns_per_op;
+    double allocs_per_op;
+    double objects_per_op;
+    long peak_rss_kb;
+    // Непустое, если нагрузка завершилась исключением: замеров тогда нет
+    std::string error;
+};
+
+long PeakRssKb() {
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+Result Measure(const Benchmark& benchmark, std::chrono::nanoseconds min_time) {
+    auto& heap = Heap::Current();
+    // Прогрев: кэши, пулы и рост буферов не входят в замер
+    benchmark.run();
+    heap.SafePoint();
+
+    uint64_t iterations = 0;
+    uint64_t ops = 0;
+    auto allocs_before = allocations.load();
+    auto objects_before = heap.Allocations();
+    auto start = std::chrono::steady_clock::now();
+    std::chrono::nanoseconds elapsed{0};
+    while (iterations == 0 || elapsed < min_time) {
+        ops += benchmark.run();
+        heap.SafePoint();
+        ++iterations;
+        elapsed = std::chrono::steady_clock::now() - start;
+    }
+    auto per_op = [ops](uint64_t total) { return static_cast<double>(total) / ops; };
+    return Result{benchmark.name,
+                  iterations,
+                  ops,
+                  per_op(elapsed.count()),
+                  per_op(allocations.load() - allocs_before),
+                  per_op(heap.Allocations() - objects_before),
+                  PeakRssKb(),
+                  {}};
+}
+
+// Строка JSON в кавычках
+std::string JsonString(const std::string& text) {
+    std::string out = "\"";
+    for (unsigned char c : text) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (c < 0x20) {
+            char escape[8];
+            std::snprintf(escape, sizeof(escape), "\\u%04x", c);
+            out += escape;
+        } else {
+            out += c;
+        }
+    }
+    return out + '"';
+}
+
+void PrintJson(const std::vector<Result>& results) {
+    std::printf("{\n  \"benchmarks\": [");
+    for (size_t i = 0; i < results.size(); ++i) {
+        auto& result = results[i];
+        if (!result.error.empty()) {
+            std::printf("%s\n    {\"name\": %s, \"error\": %s}", i ? "," : "",
+                        JsonString(result.name).c_str(), JsonString(result.error).c_str());
+            continue;
+        }
+        std::printf(
+            "%s\n    {\"name\": %s, \"iterations\": %llu, \"ops\": %llu, "
+            "\"ns_per_op\": %.3f, \"allocs_per_op\": %.3f, \"objects_per_op\": %.3f, "
+            "\"peak_rss_kb\": %ld}",
+            i ? "," : "", JsonString(result.name).c_str(),
+            static_cast<unsigned long long>(result.iterations),
+            static_cast<unsigned long long>(result.ops), result.ns_per_op, result.allocs_per_op,
+            result.objects_per_op, result.peak_rss_kb);
+    }
+    std::printf("\n  ],\n  \"peak_rss_kb\": %ld\n}\n", PeakRssKb());
+}
+////
+
+//// Нагрузки
+// Исходник в несколько мегабайт: определения, вложенные списки, числа
+// всех видов, строки, векторы и цитирование
+std::string GenerateSource(size_t forms) {
+    std::string source;
+    for (size_t i = 0; i < forms; ++i) {
+        auto n = std::to_string(i);
+        source += "(define (f" + n + " x y) (if (< x " + n + ") (+ x y 1.5) (list 'sym" + n +
+                  " \"str\" #(1 2 3) '(a . b))))\n";
+        source += "(let-like ((a " + n + ") (b 123456789012345678901234)) (* a b -7 .25e3))\n";
+    }
+    return source;
+}
+
+// Определения для вычислителя: классические тесты и размер задачи каждого
+const char kPrelude[] = R"(
+(define (fib n) (if (< n 2) n (+ (fib (- n 1)) (fib (- n 2)))))
+(define (tak x y z) (if (not (< y x)) z
+  (tak (tak (- x 1) y z) (tak (- y 1) z x) (tak (- z 1) x y))))
+(define (ack m n) (if (= m 0) (+ n 1)
+  (if (= n 0) (ack (- m 1) 1) (ack (- m 1) (ack m (- n 1))))))
+(define (build n acc) (if (= n 0) acc (build (- n 1) (cons n acc))))
+(define (rev l acc) (if (null? l) acc (rev (cdr l) (cons (car l) acc))))
+(define (make-adder n) (lambda (x) (+ x n)))
+(define (closures n acc) (if (= n 0) acc (closures (- n 1) ((make-adder n) acc))))
+(define (sum n) (if (= n 0) 0 (+ n (sum (- n 1)))))
+(define (nest n acc) (if (= n 0) acc (nest (- n 1) (list acc))))
+)";
+
+struct Workload {
+    const char* name;
+    const char* expr;
+};
+
+const Workload kWorkloads[] = {
+    {"fib", "(fib 20)"},
+    {"tak", "(tak 18 12 6)"},
+    {"ackermann", "(ack 2 9)"},
+    {"list-build-reverse", "(rev (build 10000 '()) '())"},
+    {"closures", "(closures 10000 0)"},
+    // Глубина вдвое меньше предела стека неоптимизированной сборки (compiler.cpp)
+    {"deep-recursion", "(sum 5000)"},
+};
+
+// Все формы источника по очереди
+Value EvaluateAll(Scheme* scheme, std::string_view source) {
+    Tokenizer tokenizer(source);
+    Value result;
+    while (!tokenizer.IsEnd()) {
+        result = scheme->EvaluateExpr(Read(&tokenizer));
+    }
+    return result;
+}
+////
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    std::string filter;
+    std::chrono::milliseconds min_time{300};
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--filter" && i + 1 < argc) {
+            filter = argv[++i];
+        } else if (arg == "--min-time-ms" && i + 1 < argc) {
+            min_time = std::chrono::milliseconds(std::atoi(argv[++i]));
+        } else {
+            std::cerr << "Usage: scheme_bench [--filter SUBSTRING] [--min-time-ms N]" << std::endl;
+            return 1;
+        }
+    }
+
+    try {
+        auto source = GenerateSource(20000);
+        Scheme tree;
+        Scheme bytecode;
+        bytecode.SetBackend(Backend::kBytecode);
+        EvaluateAll(&tree, kPrelude);
+        EvaluateAll(&bytecode, kPrelude);
+        EvaluateAll(&tree, "(define wide (build 100000 '())) (define deep (nest 100000 1))");
+
+        std::vector<Benchmark> benchmarks;
+        benchmarks.push_back({"tokenizer/next", [&source] {
+                                  Tokenizer tokenizer{std::string_view(source)};
+                                  uint64_t tokens = 0;
+                                  for (; !tokenizer.IsEnd(); tokenizer.Next()) {
+                                      ++tokens;
+                                  }
+                                  return tokens;
+                              }});
+        benchmarks.push_back({"reader/read", [&source] {
+                                  Tokenizer tokenizer{std::string_view(source)};
+                                  uint64_t forms = 0;
+                                  for (; !tokenizer.IsEnd(); ++forms) {
+                                      Read(&tokenizer);
+                                  }
+                                  return forms;
+                              }});
+        for (auto [scheme, backend] : {std::pair{&tree, "tree"}, std::pair{&bytecode, "vm"}}) {
+            for (auto& workload : kWorkloads) {
+                std::string expr = workload.expr;
+                benchmarks.push_back({std::string("eval/") + backend + "/" + workload.name,
+                                      [scheme = scheme, expr] {
+                                          EvaluateAll(scheme, expr);
+                                          return uint64_t(1);
+                                      }});
+            }
+        }
+        // Значения живут в глобальных переменных, так что сборка их не тронет
+        auto wide = EvaluateAll(&tree, "wide");
+        auto deep = EvaluateAll(&tree, "deep");
+        benchmarks.push_back({"printer/wide-list", [wide] {
+                                  Print(wide);
+                                  return uint64_t(1);
+                              }});
+        benchmarks.push_back({"printer/deep-nesting", [deep] {
+                                  Print(deep);
+                                  return uint64_t(1);
+                              }});
+
+        // Ошибка одной нагрузки попадает в её запись, остальные замеряются
+        std::vector<Result> results;
+        bool failed = false;
+        for (auto& benchmark : benchmarks) {
+            if (benchmark.name.find(filter) == std::string::npos) {
+                continue;
+            }
+            try {
+                results.push_back(Measure(benchmark, min_time));
+            } catch (const std::exception& e) {
+                Result result{};
+                result.name = benchmark.name;
+                result.error = e.what();
+                results.push_back(std::move(result));
+                failed = true;
+            }
+        }
+        PrintJson(results);
+        if (failed) {
+            return 1;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
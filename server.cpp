@@ -0,0 +1,312 @@
+#include "server.h"
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <csignal>
+#include <cstring>
+#include <map>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+std::runtime_error SystemError(const char *what) {
+  return std::runtime_error(std::string(what) + ": " + std::strerror(errno));
+}
+
+// Кадры "<длина>\n<текст>" из fd: чтение блоками, кадр может лежать
+// на границе блоков
+class FrameReader {
+public:
+  explicit FrameReader(int fd) : fd_(fd) {}
+
+  // false в конце ввода; исключение на обрыве кадра или неверном заголовке
+  bool Next(std::string *payload) {
+    size_t newline;
+    while ((newline = buffer_.find('\n', start_)) == std::string::npos) {
+      if (buffer_.size() - start_ > 32) {
+        throw std::runtime_error("Malformed frame header");
+      }
+      if (!Fill()) {
+        if (start_ == buffer_.size()) {
+          return false;
+        }
+        throw std::runtime_error("Unexpected end of input");
+      }
+    }
+    size_t size = 0;
+    auto header = buffer_.data() + start_;
+    auto [end, error] = std::from_chars(header, buffer_.data() + newline, size);
+    if (error != std::errc() || end != buffer_.data() + newline ||
+        size > Server::kMaxRequestSize) {
+      throw std::runtime_error("Malformed frame header");
+    }
+    start_ = newline + 1;
+    while (buffer_.size() - start_ < size) {
+      if (!Fill()) {
+        throw std::runtime_error("Unexpected end of input");
+      }
+    }
+    payload->assign(buffer_, start_, size);
+    start_ += size;
+    return true;
+  }
+
+private:
+  static const size_t kChunkSize = 1 << 16;
+
+  // Дочитывает блок, сдвигая непрочитанное в начало буфера
+  bool Fill() {
+    buffer_.erase(0, start_);
+    start_ = 0;
+    auto size = buffer_.size();
+    buffer_.resize(size + kChunkSize);
+    ssize_t got;
+    do {
+      got = read(fd_, buffer_.data() + size, kChunkSize);
+    } while (got < 0 && errno == EINTR);
+    if (got < 0) {
+      buffer_.resize(size);
+      throw SystemError("Input error");
+    }
+    buffer_.resize(size + got);
+    return got > 0;
+  }
+
+  int fd_;
+  std::string buffer_;
+  size_t start_ = 0;
+};
+
+std::string Response(const char *status, const std::string &payload) {
+  return std::string(status) + ' ' + std::to_string(payload.size()) + '\n' +
+         payload;
+}
+
+// Формы запроса по очереди; значения печатаются по строке, как в пакетном режиме
+std::string Evaluate(Scheme *scheme, const std::string &source) {
+  std::string out;
+  try {
+    Tokenizer tokenizer{std::string_view(source)};
+    while (!tokenizer.IsEnd()) {
+      auto size = out.size();
+      PrintTo(scheme->EvaluateExpr(Read(&tokenizer)), &out);
+      if (out.size() != size) {
+        out += '\n';
+      }
+    }
+  } catch (const std::exception &e) {
+    return Response("error", std::string(e.what()) + '\n');
+  }
+  return Response("ok", out);
+}
+
+} // namespace
+
+//// Соединение: ответы пишутся по порядку номеров запросов
+// Рабочий только кладёт ответ в ready и не ждёт клиента: в сокет пишет
+// поток записи соединения (WriteLoop), уже без блокировки
+struct Server::Connection {
+  explicit Connection(int fd) : output(fd) {}
+
+  // Готовый ответ ждёт в ready, пока не записаны все предыдущие
+  void Complete(uint64_t sequence, std::string response) {
+    std::lock_guard lock(mutex);
+    ready.emplace(sequence, std::move(response));
+    if (ready.begin()->first == taken) {
+      changed.notify_one();
+    }
+  }
+
+  // Ответов больше count не будет: WriteLoop вернётся, записав их все
+  void Finish(uint64_t count) {
+    std::lock_guard lock(mutex);
+    total = count;
+    changed.notify_one();
+  }
+
+  // Переносит ответы по порядку в буфер вывода и пишет их, пока не
+  // записаны все total
+  void WriteLoop() {
+    bool failed = false;
+    while (true) {
+      {
+        std::unique_lock lock(mutex);
+        changed.wait(lock, [this] {
+          return taken == total ||
+                 (!ready.empty() && ready.begin()->first == taken);
+        });
+        if (taken == total) {
+          return;
+        }
+        while (!ready.empty() && ready.begin()->first == taken) {
+          *output.Buffer() += ready.begin()->second;
+          ready.erase(ready.begin());
+          ++taken;
+        }
+      }
+      if (failed) {
+        // Клиент ушёл: оставшиеся ответы некому отдать
+        output.Buffer()->clear();
+        continue;
+      }
+      try {
+        output.Flush();
+      } catch (const std::exception &) {
+        failed = true;
+      }
+    }
+  }
+
+  std::mutex mutex;
+  std::condition_variable changed;
+  std::map<uint64_t, std::string> ready;
+  // Номер следующего ответа для записи и число ответов; пока ввод не
+  // кончился, их число неизвестно
+  uint64_t taken = 0;
+  uint64_t total = UINT64_MAX;
+  // Только у потока записи
+  OutputBuffer output;
+};
+////
+
+//// Server
+Server::Server(size_t workers, Backend backend)
+    : backend_(backend), capacity_(4 * workers) {
+  for (size_t i = 0; i < workers; ++i) {
+    workers_.emplace_back([this] { WorkerLoop(); });
+  }
+}
+
+Server::~Server() {
+  // Соединениям нужны рабочие: сначала дожидаемся их, потом останавливаем пул
+  DrainConnections();
+  {
+    std::lock_guard lock(mutex_);
+    stopping_ = true;
+  }
+  has_jobs_.notify_all();
+  for (auto &worker : workers_) {
+    worker.join();
+  }
+}
+
+void Server::Submit(Job job) {
+  std::unique_lock lock(mutex_);
+  has_space_.wait(lock, [this] { return queue_.size() < capacity_; });
+  queue_.push_back(std::move(job));
+  lock.unlock();
+  has_jobs_.notify_one();
+}
+
+void Server::WorkerLoop() {
+  Scheme scheme;
+  scheme.SetBackend(backend_);
+  while (true) {
+    std::unique_lock lock(mutex_);
+    has_jobs_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+    if (queue_.empty()) {
+      return;
+    }
+    auto job = std::move(queue_.front());
+    queue_.pop_front();
+    lock.unlock();
+    has_space_.notify_one();
+
+    scheme.Reset();
+    auto response = Evaluate(&scheme, job.source);
+    job.connection->Complete(job.sequence, std::move(response));
+  }
+}
+
+void Server::Serve(int in_fd, int out_fd) {
+  auto connection = std::make_shared<Connection>(out_fd);
+  std::thread writer([connection] { connection->WriteLoop(); });
+  FrameReader reader(in_fd);
+  uint64_t requests = 0;
+  std::string source;
+  try {
+    while (reader.Next(&source)) {
+      Submit(Job{connection, requests++, std::move(source)});
+    }
+  } catch (const std::exception &e) {
+    // Дальше поток кадров не разобрать: ошибка - последний ответ соединения
+    connection->Complete(requests++,
+                         Response("error", std::string(e.what()) + '\n'));
+  }
+  connection->Finish(requests);
+  writer.join();
+}
+
+void Server::Listen(const std::string &path) {
+  // Запись в закрытый клиентом сокет - ошибка write, а не завершение процесса
+  std::signal(SIGPIPE, SIG_IGN);
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(address.sun_path)) {
+    throw std::runtime_error("Socket path is too long");
+  }
+  std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+  int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listener < 0) {
+    throw SystemError("socket");
+  }
+  unlink(path.c_str());
+  if (bind(listener, reinterpret_cast<sockaddr *>(&address),
+           sizeof(address)) < 0 ||
+      listen(listener, SOMAXCONN) < 0) {
+    auto error = SystemError("bind");
+    close(listener);
+    throw error;
+  }
+  while (true) {
+    int client = accept(listener, nullptr, nullptr);
+    if (client < 0) {
+      if (errno == EINTR || errno == ECONNABORTED) {
+        continue;
+      }
+      auto error = SystemError("accept");
+      close(listener);
+      throw error;
+    }
+    {
+      std::lock_guard lock(connections_mutex_);
+      clients_.insert(client);
+    }
+    try {
+      std::thread([this, client] {
+        try {
+          Serve(client, client);
+        } catch (const std::exception &) {
+          // Соединение не обслужить (например, не создался поток записи)
+        }
+        {
+          // До close: номер сокета может сразу достаться новому соединению
+          std::lock_guard lock(connections_mutex_);
+          clients_.erase(client);
+          connections_done_.notify_all();
+        }
+        close(client);
+      }).detach();
+    } catch (...) {
+      std::lock_guard lock(connections_mutex_);
+      clients_.erase(client);
+      close(client);
+      close(listener);
+      throw;
+    }
+  }
+}
+
+void Server::DrainConnections() {
+  std::unique_lock lock(connections_mutex_);
+  // Новых запросов не будет: чтение получает конец ввода, а ответы на
+  // принятые запросы дописываются
+  for (int client : clients_) {
+    shutdown(client, SHUT_RD);
+  }
+  connections_done_.wait(lock, [this] { return clients_.empty(); });
+}
+////
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "scheme.h"
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+//// Сервер вычислений
+// Запросы - одна или несколько форм верхнего уровня - приходят кадрами
+// "<длина>\n<текст>" из потока ввода или по Unix-сокету и раздаются
+// свободным рабочим потокам. У каждого рабочего своя куча и свой Scheme,
+// общего изменяемого состояния у них нет (кроме таблицы символов), так что
+// пропускная способность растёт с числом ядер. Перед каждым запросом
+// окружение рабочего сбрасывается (Scheme::Reset): определения из одного
+// запроса не видны в другом.
+// Ответ - "ok <длина>\n" и напечатанные значения форм по строке на каждую
+// или "error <длина>\n" и сообщение. Ответы уходят в порядке запросов
+// своего соединения, независимо от того, какой рабочий закончил первым
+class Server {
+public:
+    // Наибольшая длина запроса: кадр длиннее - ошибка соединения
+    static const size_t kMaxRequestSize = 64 << 20;
+
+    Server(size_t workers, Backend backend);
+    ~Server();
+
+    Server(const Server&) = delete;
+    Server& operator=(const Server&) = delete;
+
+    // Обслуживает одно соединение: запросы из in_fd, ответы в out_fd.
+    // Возвращается, когда ввод кончился и все ответы записаны
+    void Serve(int in_fd, int out_fd);
+    // Принимает соединения на Unix-сокете path, каждое в своём потоке чтения
+    // со своим потоком записи. Возвращается только с исключением; принятые
+    // соединения дообслуживаются в деструкторе
+    void Listen(const std::string& path);
+
+private:
+    struct Connection;
+
+    struct Job {
+        std::shared_ptr<Connection> connection;
+        uint64_t sequence;
+        std::string source;
+    };
+
+    void Submit(Job job);
+    void WorkerLoop();
+    // Закрывает чтение у соединений Listen и ждёт, пока они допишут ответы
+    void DrainConnections();
+
+    Backend backend_;
+    std::vector<std::thread> workers_;
+
+    // Очередь ограничена: читатель ждёт, пока рабочие не разберут запросы
+    std::mutex mutex_;
+    std::condition_variable has_jobs_;
+    std::condition_variable has_space_;
+    std::deque<Job> queue_;
+    size_t capacity_;
+    bool stopping_ = false;
+
+    // Сокеты соединений Listen, чьи потоки ещё работают
+    std::mutex connections_mutex_;
+    std::condition_variable connections_done_;
+    std::set<int> clients_;
+};
+////
@@ -0,0 +1,139 @@
+#include "slab_pool.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+const size_t kBlockAlign = 16;
+
+size_t AlignUp(size_t size) { return (size + kBlockAlign - 1) & ~(kBlockAlign - 1); }
+
+} // namespace
+
+SlabPool::SlabPool(size_t block_size)
+    : block_size_(AlignUp(block_size)), first_block_(AlignUp(sizeof(Slab))) {}
+
+SlabPool::~SlabPool() {
+  // Slab'ы с живыми блоками остаются в памяти: их ещё могут освободить
+  for (auto *slab = owned_; slab;) {
+    auto *next = slab->next_owned;
+    slab->pool = nullptr;
+    if (slab->live == 0) {
+      std::free(slab);
+    }
+    slab = next;
+  }
+  std::free(spare_);
+}
+
+void *SlabPool::Allocate() {
+  if (!available_) {
+    Link(NewSlab());
+  }
+  auto *slab = available_;
+  void *block;
+  if (slab->free) {
+    block = slab->free;
+    slab->free = slab->free->next;
+  } else {
+    block = slab->untouched;
+    slab->untouched += block_size_;
+  }
+  ++slab->live;
+  auto *end = reinterpret_cast<char *>(slab) + kSlabSize;
+  if (!slab->free && slab->untouched + block_size_ > end) {
+    Unlink(slab);
+  }
+  return block;
+}
+
+void SlabPool::Free(void *block) {
+  auto address = reinterpret_cast<uintptr_t>(block);
+  auto *slab = reinterpret_cast<Slab *>(address & ~(kSlabSize - 1));
+  auto *free_block = static_cast<FreeBlock *>(block);
+  free_block->next = slab->free;
+  slab->free = free_block;
+  --slab->live;
+  auto *pool = slab->pool;
+  if (!pool) {
+    // Пул уже разрушен
+    if (slab->live == 0) {
+      std::free(slab);
+    }
+    return;
+  }
+  if (slab->live == 0) {
+    pool->Release(slab);
+  } else if (!slab->available) {
+    pool->Link(slab);
+  }
+}
+
+SlabPool::Slab *SlabPool::NewSlab() {
+  void *memory = spare_;
+  spare_ = nullptr;
+  if (!memory) {
+    memory = std::aligned_alloc(kSlabSize, kSlabSize);
+    if (!memory) {
+      throw std::bad_alloc();
+    }
+  }
+  auto *slab = static_cast<Slab *>(memory);
+  slab->pool = this;
+  slab->prev_owned = nullptr;
+  slab->next_owned = owned_;
+  if (owned_) {
+    owned_->prev_owned = slab;
+  }
+  owned_ = slab;
+  slab->prev = nullptr;
+  slab->next = nullptr;
+  slab->available = false;
+  slab->free = nullptr;
+  slab->untouched = static_cast<char *>(memory) + first_block_;
+  slab->live = 0;
+  return slab;
+}
+
+void SlabPool::Link(Slab *slab) {
+  slab->available = true;
+  slab->prev = nullptr;
+  slab->next = available_;
+  if (available_) {
+    available_->prev = slab;
+  }
+  available_ = slab;
+}
+
+void SlabPool::Unlink(Slab *slab) {
+  slab->available = false;
+  if (slab->prev) {
+    slab->prev->next = slab->next;
+  } else {
+    available_ = slab->next;
+  }
+  if (slab->next) {
+    slab->next->prev = slab->prev;
+  }
+}
+
+void SlabPool::Release(Slab *slab) {
+  if (slab->available) {
+    Unlink(slab);
+  }
+  if (slab->prev_owned) {
+    slab->prev_owned->next_owned = slab->next_owned;
+  } else {
+    owned_ = slab->next_owned;
+  }
+  if (slab->next_owned) {
+    slab->next_owned->prev_owned = slab->prev_owned;
+  }
+  if (spare_) {
+    std::free(slab);
+  } else {
+    spare_ = slab;
+  }
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+
+//// Пул блоков одного размера
+// Память берётся slab'ами по kSlabSize байт, выровненными по своему размеру:
+// slab блока находится маской адреса, поэтому Free не нужен сам пул.
+// У каждого slab'а свой список свободных блоков и счётчик занятых: slab,
+// в котором не осталось живых блоков, сразу возвращается системе, так что
+// освобождение большого списка или результата разбора отдаёт память целиком.
+// Пул не потокобезопасен: блоки освобождаются в том же потоке, где выделены
+class SlabPool {
+public:
+    static const size_t kSlabSize = 64 << 10;
+
+    explicit SlabPool(size_t block_size);
+    ~SlabPool();
+
+    SlabPool(const SlabPool&) = delete;
+    SlabPool& operator=(const SlabPool&) = delete;
+
+    void* Allocate();
+    static void Free(void* block);
+
+private:
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+
+    struct Slab {
+        SlabPool* pool;
+        // Все slab'ы пула
+        Slab* prev_owned;
+        Slab* next_owned;
+        // Список slab'ов, в которых есть свободные блоки
+        Slab* prev;
+        Slab* next;
+        bool available;
+        FreeBlock* free;
+        // Ещё ни разу не выданная часть slab'а
+        char* untouched;
+        size_t live;
+    };
+
+    Slab* NewSlab();
+    void Link(Slab* slab);
+    void Unlink(Slab* slab);
+    void Release(Slab* slab);
+
+    size_t block_size_;
+    size_t first_block_;
+    Slab* owned_ = nullptr;
+    Slab* available_ = nullptr;
+    // Один пустой slab держится про запас, чтобы не дёргать систему на границе
+    Slab* spare_ = nullptr;
+};
+////
@@ -3,28 +3,64 @@
 #include <variant>
 #include <iostream>
 #include <vector>
+#include <string>
+#include <string_view>
+#include <charconv>
+#include <cstdlib>
+#include <stdexcept>
 
+// Ошибка в тексте программы: лексическая (tokenizer) или синтаксическая (Read)
+struct SyntaxError : public std::runtime_error {
+    explicit SyntaxError(const std::string& what) : std::runtime_error(what) {
+    }
+};
+
+// name указывает либо в исходный буфер, либо во внутренний буфер Tokenizer'а
+// и действителен до следующего вызова Tokenizer::Next()
 struct SymbolToken {
-    std::string name;
+    std::string_view name;
 };
 
 struct QuoteToken {};
 
 struct DotToken {};
 
+// Строковый литерал с уже разобранными escape-последовательностями;
+// text действителен до следующего Next()
+struct StringToken {
+    std::string_view text;
+};
+
+// Открывающая скобка литерала вектора #( ; закрывается обычной CLOSE
+struct VectorToken {};
+
 enum class BracketToken { OPEN, CLOSE };
 
+// Целая константа. Если она не помещается в int64, digits - её текст
+// (действителен, как и name у SymbolToken, до следующего Next()), а value не задан
 struct ConstantToken {
-    int value;
+    int64_t value;
+    std::string_view digits;
+};
+
+// Вещественная константа: есть дробная часть или порядок
+struct FlonumToken {
+    double value;
 };
 
-typedef std::variant<SymbolToken, ConstantToken, BracketToken, QuoteToken, DotToken> Token;
+typedef std::variant<SymbolToken, ConstantToken, FlonumToken, BracketToken, QuoteToken,
+                     DotToken, VectorToken, StringToken>
+    Token;
 
 inline bool operator==(const SymbolToken& lhs, const SymbolToken& rhs) {
     return lhs.name == rhs.name;
 }
 
 inline bool operator==(const ConstantToken& lhs, const ConstantToken& rhs) {
+    return lhs.value == rhs.value && lhs.digits == rhs.digits;
+}
+
+inline bool operator==(const FlonumToken& lhs, const FlonumToken& rhs) {
     return lhs.value == rhs.value;
 }
 
@@ -36,6 +72,14 @@ inline bool operator==(const DotToken& lhs, const DotToken& rhs) {
     return true;
 }
 
+inline bool operator==(const VectorToken& lhs, const VectorToken& rhs) {
+    return true;
+}
+
+inline bool operator==(const StringToken& lhs, const StringToken& rhs) {
+    return lhs.text == rhs.text;
+}
+
 std::vector<Token> Read(const std::string& string);
 
 class Tokenizer {
@@ -45,56 +89,75 @@ public:
         Next();
     }
 
+    // Режим без копирования: имена SymbolToken указывают прямо в buffer,
+    // который должен жить дольше токенизатора
+    explicit Tokenizer(std::string_view buffer) : buffer_(buffer) {
+        Next();
+    }
+
     bool IsEnd() {
         return eof_;
     }
 
     void Next() {
-        while (in_stream_->peek() == ' ') {
-            in_stream_->get();
+        while (IsSpace(Peek())) {
+            Skip();
         }
-        std::string current_char;
-        if (std::isdigit(in_stream_->peek()) || in_stream_->peek() == '-' ||
-            in_stream_->peek() == '+') {
-            current_char += in_stream_->get();
-            while (in_stream_->peek() != ' ' && in_stream_->peek() != EOF &&
-                   std::isdigit(in_stream_->peek())) {
-                current_char += in_stream_->get();
+        BeginText();
+        int current_char = Peek();
+        if (std::isdigit(current_char) || current_char == '-' || current_char == '+') {
+            Take();
+            bool digits = std::isdigit(current_char);
+            digits = TakeDigits() || digits;
+            bool real = false;
+            if (Peek() == '.') {
+                Take();
+                real = true;
+                digits = TakeDigits() || digits;
+            }
+            if (digits && TakeExponent()) {
+                real = true;
             }
-            if (std::isdigit(current_char[0]) ||
-                (current_char.size() > 1 && current_char[0] == '-') ||
-                (current_char.size() > 1 && current_char[0] == '+')) {
-                current_token_ = Token{ConstantToken{std::stoi(current_char)}};
+            if (!digits) {
+                // Одиночные + и -, а не число
+                current_token_ = Token(SymbolToken{Text()});
+            } else if (real) {
+                current_token_ = Token{FlonumToken{ParseReal(Text())}};
             } else {
-                current_token_ = Token(SymbolToken{current_char});
+                current_token_ = Token{ParseInt(Text())};
             }
-        }
-        //        else if (std::isalpha(in_stream_->peek())) {
-        //            while (in_stream_->peek() != ' ' && in_stream_->peek() != EOF) {
-        //                current_char += in_stream_->get();
-        //            }
-        //            current_token_ = Token(SymbolToken{current_char});
-        //        }
-        else if (in_stream_->peek() == EOF) {
+        } else if (current_char == EOF) {
             eof_ = true;
         } else {
-            current_char = in_stream_->get();
-            if (current_char[0] == '.') {
+            Skip();
+            if (current_char == '.' && std::isdigit(Peek())) {
+                // .5 - число, а не точка пары
+                BeginText(current_char);
+                TakeDigits();
+                TakeExponent();
+                current_token_ = Token{FlonumToken{ParseReal(Text())}};
+            } else if (current_char == '.') {
                 current_token_ = Token(DotToken());
-            } else if (current_char[0] == '(') {
+            } else if (current_char == '(') {
                 ++bracket_balance_;
                 current_token_ = Token(BracketToken::OPEN);
-            } else if (current_char[0] == ')') {
+            } else if (current_char == ')') {
                 --bracket_balance_;
                 current_token_ = Token(BracketToken::CLOSE);
-            } else if (current_char[0] == '\'') {
+            } else if (current_char == '\'') {
                 current_token_ = Token(QuoteToken{});
+            } else if (current_char == '"') {
+                current_token_ = Token(StringToken{TakeString()});
+            } else if (current_char == '#' && Peek() == '(') {
+                Skip();
+                ++bracket_balance_;
+                current_token_ = Token(VectorToken{});
             } else {
-                while (in_stream_->peek() != ' ' && in_stream_->peek() != EOF &&
-                       in_stream_->peek() != ')' && in_stream_->peek() != '(' && in_stream_->peek() != '\n') {
-                    current_char += in_stream_->get();
+                BeginText(current_char);
+                while (!IsSpace(Peek()) && Peek() != EOF && Peek() != ')' && Peek() != '(') {
+                    Take();
                 }
-                current_token_ = Token(SymbolToken{current_char});
+                current_token_ = Token(SymbolToken{Text()});
             }
         }
     }
@@ -108,7 +171,141 @@ public:
     }
 
 private:
-    std::istream* in_stream_;
+    static bool IsSpace(int c) {
+        return c == ' ' || c == '\n' || c == '\t' || c == '\r';
+    }
+
+    static ConstantToken ParseInt(std::string_view text) {
+        if (text[0] == '+') {
+            text.remove_prefix(1);
+        }
+        int64_t value = 0;
+        auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+        if (ec == std::errc::result_out_of_range) {
+            return ConstantToken{0, text};
+        }
+        if (ec != std::errc() || ptr != text.data() + text.size()) {
+            throw SyntaxError("Invalid integer constant");
+        }
+        return ConstantToken{value, {}};
+    }
+
+    static double ParseReal(std::string_view text) {
+        if (text[0] == '+') {
+            text.remove_prefix(1);
+        }
+        double value = 0;
+        auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+        if (ec == std::errc::invalid_argument || ptr != text.data() + text.size()) {
+            throw SyntaxError("Invalid real constant");
+        }
+        // Вне диапазона double from_chars не пишет в value; strtod даёт
+        // бесконечность или ноль
+        if (ec == std::errc::result_out_of_range) {
+            value = std::strtod(std::string(text).c_str(), nullptr);
+        }
+        return value;
+    }
+
+    // Возвращают, был ли взят хотя бы один символ
+    bool TakeDigits() {
+        bool taken = false;
+        while (std::isdigit(Peek())) {
+            Take();
+            taken = true;
+        }
+        return taken;
+    }
+
+    bool TakeExponent() {
+        if (Peek() != 'e' && Peek() != 'E') {
+            return false;
+        }
+        Take();
+        if (Peek() == '-' || Peek() == '+') {
+            Take();
+        }
+        TakeDigits();
+        return true;
+    }
+
+    // Содержимое строки после открывающей кавычки. Текст всегда собирается
+    // в text_: escape-последовательности не дают взять срез буфера
+    std::string_view TakeString() {
+        text_.clear();
+        while (true) {
+            int c = Peek();
+            if (c == EOF) {
+                throw SyntaxError("Unterminated string literal");
+            }
+            Skip();
+            if (c == '"') {
+                return text_;
+            }
+            if (c == '\\') {
+                c = Peek();
+                if (c == EOF) {
+                    throw SyntaxError("Unterminated string literal");
+                }
+                Skip();
+                if (c == 'n') {
+                    c = '\n';
+                } else if (c == 't') {
+                    c = '\t';
+                } else if (c == 'r') {
+                    c = '\r';
+                }
+            }
+            text_ += static_cast<char>(c);
+        }
+    }
+
+    int Peek() {
+        if (in_stream_) {
+            return in_stream_->peek();
+        }
+        return pos_ < buffer_.size() ? static_cast<unsigned char>(buffer_[pos_]) : EOF;
+    }
+
+    void Skip() {
+        if (in_stream_) {
+            in_stream_->get();
+        } else {
+            ++pos_;
+        }
+    }
+
+    // Текст токена: в буферном режиме это срез buffer_, в потоковом — text_
+    void BeginText() {
+        text_start_ = pos_;
+        text_.clear();
+    }
+
+    void BeginText(int first_char) {
+        text_start_ = pos_ - 1;
+        text_.assign(1, static_cast<char>(first_char));
+    }
+
+    void Take() {
+        if (in_stream_) {
+            text_ += static_cast<char>(in_stream_->get());
+        } else {
+            ++pos_;
+        }
+    }
+
+    std::string_view Text() {
+        if (in_stream_) {
+            return text_;
+        }
+        return buffer_.substr(text_start_, pos_ - text_start_);
+    }
+
+    std::istream* in_stream_ = nullptr;
+    std::string_view buffer_;
+    size_t pos_ = 0;
+    size_t text_start_ = 0;
+    std::string text_;
     Token current_token_;
     bool eof_ = false;
     int64_t bracket_balance_ = 0;
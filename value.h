@@ -0,0 +1,172 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+
+class Heap;
+
+// Тег конкретного вида объекта: проверка типа - одно сравнение байта
+// вместо обхода RTTI
+enum class ObjectType : uint8_t {
+    kNumber,
+    kFlonum,
+    kSymbol,
+    kCell,
+    kVector,
+    kS64Vector,
+    kF64Vector,
+    kHashTable,
+    kString,
+    kStringPort,
+    kBuiltin,
+    kLambda,
+    kSyntax,
+    kFrame,
+};
+const size_t kObjectTypeCount = static_cast<size_t>(ObjectType::kFrame) + 1;
+
+//// Базовый object
+// Объекты регистрируются в куче своего потока при создании и освобождаются
+// сборщиком (gc.h), когда становятся недостижимы из корней. Конструкторы
+// наследников не должны бросать исключений: объект уже зарегистрирован
+class Object {
+public:
+    explicit Object(ObjectType type);
+    Object(const Object&) = delete;
+    Object& operator=(const Object&) = delete;
+    virtual ~Object() = default;
+
+    // Дописывает запись объекта в out. Пары и векторы обходит без рекурсии
+    // печать из printer.h, остальные объекты печатают себя сами
+    virtual void PrintTo(std::string* out);
+    // Отмечает в heap объекты, на которые ссылается этот
+    virtual void Trace(Heap* heap) {
+    }
+    // Память объекта вместе с принадлежащими ему буферами (для статистики)
+    virtual size_t ByteSize() const {
+        return sizeof(Object);
+    }
+
+    ObjectType Type() const {
+        return type_;
+    }
+
+protected:
+    struct Permanent {};
+    // Постоянный объект не попадает в кучу и никогда не освобождается;
+    // он всегда считается отмеченным, поэтому сборщик его не трогает
+    Object(ObjectType type, Permanent) : marked_(true), type_(type) {
+    }
+
+private:
+    friend class Heap;
+
+    Object* next_ = nullptr;
+    bool marked_ = false;
+    ObjectType type_;
+};
+
+// Добавляет память нового объекта к счётчику кучи потока (gc.h)
+void NoteObjectBytes(size_t bytes);
+
+template <class T, class... Args>
+T* New(Args&&... args) {
+    auto obj = new T(std::forward<Args>(args)...);
+    // Вид объекта известен, так что размер берётся без виртуального вызова
+    NoteObjectBytes(obj->T::ByteSize());
+    return obj;
+}
+
+// Проверенное приведение по тегу: nullptr, если объект другого вида.
+// Класс T объявляет static bool HasType(ObjectType)
+template <class T>
+T* As(Object* obj) {
+    return obj && T::HasType(obj->Type()) ? static_cast<T*>(obj) : nullptr;
+}
+////
+
+//// Значение: одно машинное слово с тегом в младших битах
+// ...xxx1 - fixnum, 63-битное целое со сдвигом на 1
+// ...x010 - #f / #t, значение в бите 3
+// ....000 - указатель на Object (объекты выровнены по 8); ноль - пустой список
+// Числа, булевы и () не выделяются в куче. Копирование - копирование слова:
+// временем жизни объектов управляет сборщик
+class Value {
+public:
+    static const int64_t kMaxFixnum = (int64_t(1) << 62) - 1;
+    static const int64_t kMinFixnum = -(int64_t(1) << 62);
+
+    Value() = default;
+    Value(std::nullptr_t) {
+    }
+    Value(Object* obj) : bits_(reinterpret_cast<uint64_t>(obj)) {
+    }
+
+    static bool FitsFixnum(int64_t value) {
+        return value >= kMinFixnum && value <= kMaxFixnum;
+    }
+    static Value Fixnum(int64_t value) {
+        return FromBits(static_cast<uint64_t>(value) << 1 | kFixnumTag);
+    }
+    static Value Bool(bool value) {
+        return FromBits(value ? kTrue : kFalse);
+    }
+
+    bool IsFixnum() const {
+        return bits_ & kFixnumTag;
+    }
+    bool IsBool() const {
+        return (bits_ & kTagMask) == kBoolTag;
+    }
+    bool IsNull() const {
+        return bits_ == 0;
+    }
+    bool IsObject() const {
+        return bits_ != 0 && (bits_ & kTagMask) == 0;
+    }
+
+    int64_t GetFixnum() const {
+        return static_cast<int64_t>(bits_) >> 1;
+    }
+    bool GetBool() const {
+        return bits_ == kTrue;
+    }
+    // nullptr для непосредственных значений
+    Object* GetObject() const {
+        return IsObject() ? reinterpret_cast<Object*>(bits_) : nullptr;
+    }
+
+    // Ложно только для пустого списка
+    explicit operator bool() const {
+        return bits_ != 0;
+    }
+    // Совпадение слов: одинаковые непосредственные значения или один и тот же объект
+    bool operator==(const Value& other) const {
+        return bits_ == other.bits_;
+    }
+    bool operator!=(const Value& other) const {
+        return bits_ != other.bits_;
+    }
+    // Слово целиком: хеш по тождеству
+    uint64_t Bits() const {
+        return bits_;
+    }
+
+private:
+    static const uint64_t kFixnumTag = 1;
+    static const uint64_t kTagMask = 7;
+    static const uint64_t kBoolTag = 2;
+    static const uint64_t kFalse = kBoolTag;
+    static const uint64_t kTrue = kBoolTag | 8;
+
+    static Value FromBits(uint64_t bits) {
+        Value value;
+        value.bits_ = bits;
+        return value;
+    }
+
+    uint64_t bits_ = 0;
+};
+////
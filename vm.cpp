@@ -0,0 +1,529 @@
+#include "vm.h"
+#include "gc.h"
+#include "profiler.h"
+#include "runtime_stats.h"
+#include "scheme.h"
+
+#if defined(__GNUC__) && !defined(SCHEME_VM_NO_COMPUTED_GOTO)
+#define SCHEME_VM_COMPUTED_GOTO 1
+#endif
+
+namespace {
+
+const size_t kStackSize = 1 << 18;
+const uint32_t kMaxSlotIndex = 0xFFFF;
+
+// Изменение глубины стека выражений после инструкции
+int
+StackEffect(OpCode op, uint32_t arg) {
+  switch (op) {
+  case OpCode::kConst:
+  case OpCode::kLoadLocal:
+  case OpCode::kLoadOuter:
+  case OpCode::kLoadGlobal:
+  case OpCode::kMakeClosure:
+    return 1;
+  case OpCode::kStoreLocal:
+  case OpCode::kStoreOuter:
+  case OpCode::kDefineGlobal:
+  case OpCode::kSetGlobal:
+  case OpCode::kPop:
+  case OpCode::kJumpIfFalse:
+  case OpCode::kJumpIfFalseOrPop:
+  case OpCode::kJumpIfTrueOrPop:
+  case OpCode::kReturn:
+    return -1;
+  case OpCode::kCall:
+  case OpCode::kTailCall:
+    return -static_cast<int>(arg);
+  case OpCode::kJump:
+  case OpCode::kProfileBegin:
+  case OpCode::kProfileEnd:
+    return 0;
+  }
+  return 0;
+}
+
+} // namespace
+
+//// BytecodeEmitter
+std::shared_ptr<BytecodeProto>
+BytecodeEmitter::CompileTopLevel(CompiledNode *node) {
+  auto proto = std::make_shared<BytecodeProto>();
+  BytecodeEmitter emitter;
+  emitter.proto_ = proto.get();
+  node->Emit(&emitter);
+  emitter.Emit(OpCode::kReturn);
+  return proto;
+}
+
+const BytecodeProto *BytecodeEmitter::CompileLambda(LambdaCode *code) {
+  if (!code->bytecode) {
+    auto proto = std::make_shared<BytecodeProto>();
+    BytecodeEmitter emitter;
+    emitter.proto_ = proto.get();
+    for (size_t i = 0; i < code->body.size(); ++i) {
+      if (i > 0) {
+        emitter.Emit(OpCode::kPop);
+      }
+      code->body[i]->Emit(&emitter);
+    }
+    emitter.Emit(OpCode::kReturn);
+    code->bytecode = proto;
+  }
+  return code->bytecode.get();
+}
+
+void BytecodeEmitter::Emit(OpCode op, uint32_t arg) {
+  proto_->code.push_back(Instruction{op, arg});
+  AdjustStack(StackEffect(op, arg));
+}
+
+void BytecodeEmitter::AdjustStack(int delta) {
+  stack_depth_ += delta;
+  if (stack_depth_ > static_cast<int>(proto_->max_stack)) {
+    proto_->max_stack = stack_depth_;
+  }
+}
+
+void BytecodeEmitter::EmitConstant(Value value) {
+  proto_->constants.push_back(std::move(value));
+  Emit(OpCode::kConst, proto_->constants.size() - 1);
+}
+
+void BytecodeEmitter::EmitLambda(std::shared_ptr<LambdaCode> code) {
+  proto_->lambdas.push_back(std::move(code));
+  Emit(OpCode::kMakeClosure, proto_->lambdas.size() - 1);
+}
+
+void BytecodeEmitter::EmitGlobal(OpCode op, GlobalSlot *slot) {
+  proto_->globals.push_back(slot);
+  Emit(op, proto_->globals.size() - 1);
+}
+
+void BytecodeEmitter::EmitSlot(OpCode local_op, OpCode outer_op,
+                               uint32_t depth, uint32_t slot) {
+  if (depth == 0) {
+    Emit(local_op, slot);
+    return;
+  }
+  if (depth > kMaxSlotIndex || slot > kMaxSlotIndex) {
+    throw SyntaxError("Too deep nesting of lambdas");
+  }
+  Emit(outer_op, depth << 16 | slot);
+}
+
+size_t BytecodeEmitter::EmitJump(OpCode op) {
+  Emit(op);
+  return proto_->code.size() - 1;
+}
+
+void BytecodeEmitter::PatchJump(size_t position) {
+  proto_->code[position].arg = proto_->code.size();
+}
+////
+
+//// Генерация байткода для нод
+void ConstantNode::Emit(BytecodeEmitter *emitter) {
+  emitter->EmitConstant(value_);
+}
+
+void VariableNode::Emit(BytecodeEmitter *emitter) {
+  emitter->EmitSlot(OpCode::kLoadLocal, OpCode::kLoadOuter, depth_, slot_);
+}
+
+void GlobalVariableNode::Emit(BytecodeEmitter *emitter) {
+  emitter->EmitGlobal(OpCode::kLoadGlobal, &slot_);
+}
+
+void CallNode::Emit(BytecodeEmitter *emitter) {
+  op_->Emit(emitter);
+  for (auto &arg : args_) {
+    arg->Emit(emitter);
+  }
+  emitter->Emit(tail_ ? OpCode::kTailCall : OpCode::kCall, args_.size());
+}
+
+void IfNode::Emit(BytecodeEmitter *emitter) {
+  condition_->Emit(emitter);
+  auto to_false = emitter->EmitJump(OpCode::kJumpIfFalse);
+  true_branch_->Emit(emitter);
+  auto to_end = emitter->EmitJump(OpCode::kJump);
+  // Ветка else начинается с той же глубины, что и then
+  emitter->AdjustStack(-1);
+  emitter->PatchJump(to_false);
+  if (false_branch_) {
+    false_branch_->Emit(emitter);
+  } else {
+    emitter->EmitConstant(nullptr);
+  }
+  emitter->PatchJump(to_end);
+}
+
+void AssignNode::Emit(BytecodeEmitter *emitter) {
+  value_->Emit(emitter);
+  emitter->EmitSlot(OpCode::kStoreLocal, OpCode::kStoreOuter, depth_, slot_);
+  emitter->EmitConstant(result_);
+}
+
+void DefineNode::Emit(BytecodeEmitter *emitter) {
+  value_->Emit(emitter);
+  emitter->EmitGlobal(OpCode::kDefineGlobal, &slot_);
+  emitter->EmitConstant(result_);
+}
+
+void SetNode::Emit(BytecodeEmitter *emitter) {
+  value_->Emit(emitter);
+  emitter->EmitGlobal(OpCode::kSetGlobal, &slot_);
+  emitter->EmitConstant(result_);
+}
+
+void AndNode::Emit(BytecodeEmitter *emitter) {
+  if (args_.empty()) {
+    emitter->EmitConstant(Value::Bool(true));
+    return;
+  }
+  std::vector<size_t> to_end;
+  for (size_t i = 0; i + 1 < args_.size(); ++i) {
+    args_[i]->Emit(emitter);
+    to_end.push_back(emitter->EmitJump(OpCode::kJumpIfFalseOrPop));
+  }
+  args_.back()->Emit(emitter);
+  for (auto jump : to_end) {
+    emitter->PatchJump(jump);
+  }
+}
+
+void OrNode::Emit(BytecodeEmitter *emitter) {
+  if (args_.empty()) {
+    emitter->EmitConstant(Value::Bool(false));
+    return;
+  }
+  std::vector<size_t> to_end;
+  for (size_t i = 0; i + 1 < args_.size(); ++i) {
+    args_[i]->Emit(emitter);
+    to_end.push_back(emitter->EmitJump(OpCode::kJumpIfTrueOrPop));
+  }
+  args_.back()->Emit(emitter);
+  for (auto jump : to_end) {
+    emitter->PatchJump(jump);
+  }
+}
+
+void LambdaNode::Emit(BytecodeEmitter *emitter) { emitter->EmitLambda(code_); }
+
+void ProfileNode::Emit(BytecodeEmitter *emitter) {
+  emitter->Emit(OpCode::kProfileBegin);
+  expr_->Emit(emitter);
+  emitter->Emit(OpCode::kProfileEnd);
+}
+////
+
+//// VirtualMachine
+VirtualMachine::VirtualMachine()
+    : stack_(new Value[kStackSize]), sp_(stack_.get()),
+      stack_end_(stack_.get() + kStackSize) {}
+
+VirtualMachine::~VirtualMachine() = default;
+
+void VirtualMachine::Trace(Heap *heap) {
+  heap->Mark(stack_.get(), sp_ - stack_.get());
+  for (auto &frame : frames_) {
+    if (frame.frame) {
+      heap->Mark(frame.frame);
+    }
+  }
+}
+
+void VirtualMachine::Unwind(Value *sp) {
+  while (sp_ > sp) {
+    *--sp_ = nullptr;
+  }
+}
+
+void VirtualMachine::CheckStack(Value *top) {
+  if (top >= stack_end_) {
+    throw RuntimeError("Stack overflow");
+  }
+}
+
+void VirtualMachine::EnterLambda(LambdaFunc *lambda,
+                                 Value *callee_slot,
+                                 uint32_t argc) {
+  LambdaCode *code = lambda->code_.get();
+  if (argc != code->params.size()) {
+    throw RuntimeError("Wrong number of arguments for lambda function");
+  }
+  auto *proto = BytecodeEmitter::CompileLambda(code);
+  // Функция и аргументы уже на стеке, который сборщик видит целиком
+  Heap::Current().SafePoint();
+  CheckStack(callee_slot + 1 + code->frame_size + proto->max_stack);
+  // Замыкание остаётся в слоте под аргументами и живёт до возврата
+  CallFrame frame{proto,   proto->code.data(), nullptr,
+                  nullptr, lambda->env_, callee_slot};
+  if (code->heap_frame) {
+    frame.frame = Frame::Create(code->frame_size, lambda->env_);
+    frame.locals = frame.frame->Slots();
+    std::move(callee_slot + 1, sp_, frame.locals);
+    Unwind(callee_slot + 1);
+  } else {
+    // Аргументы уже лежат на стеке и становятся первыми слотами кадра
+    frame.locals = callee_slot + 1;
+    sp_ = frame.locals + code->frame_size;
+  }
+  frames_.push_back(std::move(frame));
+  auto &counters = RuntimeCounters::Current();
+  ++counters.lambda_calls;
+  // Нижний кадр - входной кадр Run, а не вызов лямбды
+  counters.NoteCallDepth(frames_.size() - 1);
+  if (auto profiler = Profiler::Current()) {
+    profiler->Enter(lambda);
+  }
+}
+
+void VirtualMachine::CallBuiltin(Object *callee,
+                                 Value *callee_slot) {
+  auto fn = As<Function>(callee);
+  if (!fn) {
+    throw RuntimeError("first element must be a function");
+  }
+  ++RuntimeCounters::Current().builtin_calls;
+  auto profiler = Profiler::Current();
+  if (profiler) {
+    profiler->Enter(fn);
+  }
+  // Аргументы передаются срезом стека, без копирования
+  auto result = fn->Apply(ArgList(callee_slot + 1, sp_ - callee_slot - 1));
+  if (profiler) {
+    profiler->Exit();
+  }
+  Unwind(callee_slot);
+  *sp_++ = std::move(result);
+}
+
+Value VirtualMachine::Run(const BytecodeProto *proto,
+                                            Scope *globals) {
+  size_t entry_depth = frames_.size();
+  size_t entry_profiles = profiles_.size();
+  auto *entry_sp = sp_;
+  CheckStack(sp_ + proto->max_stack);
+  frames_.push_back(CallFrame{proto, proto->code.data(), nullptr, nullptr,
+                              nullptr, entry_sp});
+  try {
+    return Execute(entry_depth, globals);
+  } catch (...) {
+    frames_.resize(entry_depth);
+    while (profiles_.size() > entry_profiles) {
+      profiles_.pop_back();
+    }
+    Unwind(entry_sp);
+    throw;
+  }
+}
+
+Value VirtualMachine::Execute(size_t entry_depth,
+                                                Scope *globals) {
+  // Регистры текущего вызова, в frames_ сохраняется только ip при вызове
+  const BytecodeProto *proto;
+  const Instruction *ip;
+  Value *locals;
+  Frame *frame;
+  Frame *parent;
+
+#define VM_LOAD_FRAME()                                                        \
+  do {                                                                         \
+    auto &current = frames_.back();                                            \
+    proto = current.proto;                                                     \
+    ip = current.ip;                                                           \
+    locals = current.locals;                                                   \
+    frame = current.frame;                                                     \
+    parent = current.parent;                                                   \
+  } while (false)
+
+  VM_LOAD_FRAME();
+
+#ifdef SCHEME_VM_COMPUTED_GOTO
+  static void *kDispatchTable[] = {
+      &&op_kConst,          &&op_kLoadLocal,        &&op_kLoadOuter,
+      &&op_kLoadGlobal,     &&op_kStoreLocal,       &&op_kStoreOuter,
+      &&op_kDefineGlobal,   &&op_kSetGlobal,        &&op_kPop,
+      &&op_kJump,           &&op_kJumpIfFalse,      &&op_kJumpIfFalseOrPop,
+      &&op_kJumpIfTrueOrPop, &&op_kMakeClosure,     &&op_kCall,
+      &&op_kTailCall,       &&op_kReturn,           &&op_kProfileBegin,
+      &&op_kProfileEnd,
+  };
+#define VM_CASE(name) op_##name:
+#define VM_DISPATCH() goto *kDispatchTable[static_cast<size_t>(ip->op)]
+  VM_DISPATCH();
+#else
+#define VM_CASE(name) case OpCode::name:
+#define VM_DISPATCH() continue
+  while (true) {
+    switch (ip->op) {
+#endif
+
+  VM_CASE(kConst) {
+    *sp_++ = proto->constants[ip->arg];
+    ++ip;
+    VM_DISPATCH();
+  }
+  VM_CASE(kLoadLocal) {
+    *sp_++ = locals[ip->arg];
+    ++ip;
+    VM_DISPATCH();
+  }
+  VM_CASE(kLoadOuter) {
+    Frame *outer = parent;
+    for (uint32_t i = 1; i < (ip->arg >> 16); ++i) {
+      outer = outer->Parent();
+    }
+    *sp_++ = outer->Slots()[ip->arg & kMaxSlotIndex];
+    ++ip;
+    VM_DISPATCH();
+  }
+  VM_CASE(kLoadGlobal) {
+    *sp_++ = proto->globals[ip->arg]->Lookup(globals);
+    ++ip;
+    VM_DISPATCH();
+  }
+  VM_CASE(kStoreLocal) {
+    locals[ip->arg] = std::move(*--sp_);
+    ++ip;
+    VM_DISPATCH();
+  }
+  VM_CASE(kStoreOuter) {
+    Frame *outer = parent;
+    for (uint32_t i = 1; i < (ip->arg >> 16); ++i) {
+      outer = outer->Parent();
+    }
+    outer->Slots()[ip->arg & kMaxSlotIndex] = std::move(*--sp_);
+    ++ip;
+    VM_DISPATCH();
+  }
+  VM_CASE(kDefineGlobal) {
+    proto->globals[ip->arg]->Bind(globals) = *--sp_;
+    ++ip;
+    VM_DISPATCH();
+  }
+  VM_CASE(kSetGlobal) {
+    auto &cell = proto->globals[ip->arg]->Assign(globals);
+    cell = *--sp_;
+    ++ip;
+    VM_DISPATCH();
+  }
+  VM_CASE(kPop) {
+    *--sp_ = nullptr;
+    ++ip;
+    VM_DISPATCH();
+  }
+  VM_CASE(kJump) {
+    ip = proto->code.data() + ip->arg;
+    VM_DISPATCH();
+  }
+  VM_CASE(kJumpIfFalse) {
+    bool condition = IsTrue(*--sp_);
+    *sp_ = nullptr;
+    ip = condition ? ip + 1 : proto->code.data() + ip->arg;
+    VM_DISPATCH();
+  }
+  VM_CASE(kJumpIfFalseOrPop) {
+    if (IsTrue(sp_[-1])) {
+      *--sp_ = nullptr;
+      ++ip;
+    } else {
+      ip = proto->code.data() + ip->arg;
+    }
+    VM_DISPATCH();
+  }
+  VM_CASE(kJumpIfTrueOrPop) {
+    if (IsTrue(sp_[-1])) {
+      ip = proto->code.data() + ip->arg;
+    } else {
+      *--sp_ = nullptr;
+      ++ip;
+    }
+    VM_DISPATCH();
+  }
+  VM_CASE(kMakeClosure) {
+    auto new_func = New<LambdaFunc>();
+    new_func->code_ = proto->lambdas[ip->arg];
+    new_func->env_ = frame;
+    new_func->globals_ = globals;
+    *sp_++ = new_func;
+    ++ip;
+    VM_DISPATCH();
+  }
+  VM_CASE(kCall) {
+    uint32_t argc = ip->arg;
+    auto *callee_slot = sp_ - argc - 1;
+    ++ip;
+    Object *callee = callee_slot->GetObject();
+    if (auto lambda = As<LambdaFunc>(callee)) {
+      frames_.back().ip = ip;
+      EnterLambda(lambda, callee_slot, argc);
+      VM_LOAD_FRAME();
+    } else {
+      CallBuiltin(callee, callee_slot);
+    }
+    VM_DISPATCH();
+  }
+  VM_CASE(kTailCall) {
+    uint32_t argc = ip->arg;
+    auto *callee_slot = sp_ - argc - 1;
+    Object *callee = callee_slot->GetObject();
+    if (auto lambda = As<LambdaFunc>(callee)) {
+      // Функция и аргументы сдвигаются на место текущего вызова,
+      // его кадр больше не нужен
+      auto *base = frames_.back().base;
+      std::move(callee_slot, sp_, base);
+      Unwind(base + argc + 1);
+      frames_.pop_back();
+      if (auto profiler = Profiler::Current()) {
+        profiler->Exit();
+      }
+      EnterLambda(lambda, base, argc);
+      VM_LOAD_FRAME();
+    } else {
+      // Встроенные функции не растят стек, за ними следует обычный kReturn
+      CallBuiltin(callee, callee_slot);
+      ++ip;
+    }
+    VM_DISPATCH();
+  }
+  VM_CASE(kReturn) {
+    auto result = std::move(*--sp_);
+    Unwind(frames_.back().base);
+    frames_.pop_back();
+    if (frames_.size() == entry_depth) {
+      return result;
+    }
+    // Снятый кадр был кадром лямбды, а не входным кадром Run
+    if (auto profiler = Profiler::Current()) {
+      profiler->Exit();
+    }
+    *sp_++ = std::move(result);
+    VM_LOAD_FRAME();
+    VM_DISPATCH();
+  }
+  VM_CASE(kProfileBegin) {
+    profiles_.push_back(std::make_unique<ProfileSession>());
+    ++ip;
+    VM_DISPATCH();
+  }
+  VM_CASE(kProfileEnd) {
+    // Отчёт закрывает сессию: внутренние уже закрыты своими kProfileEnd
+    profiles_.back()->Finish(globals);
+    profiles_.pop_back();
+    ++ip;
+    VM_DISPATCH();
+  }
+
+#ifndef SCHEME_VM_COMPUTED_GOTO
+    }
+  }
+#endif
+#undef VM_CASE
+#undef VM_DISPATCH
+#undef VM_LOAD_FRAME
+}
+////
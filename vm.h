@@ -0,0 +1,113 @@
+#pragma once
+
+#include "compiler.h"
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class ProfileSession;
+
+//// Байткод
+enum class OpCode : uint8_t {
+    kConst,             // push constants[arg]
+    kLoadLocal,         // push слот arg текущего кадра
+    kLoadOuter,         // push слот внешнего кадра, arg = depth << 16 | slot
+    kLoadGlobal,        // push глобальную переменную globals[arg]
+    kStoreLocal,        // pop -> слот arg текущего кадра
+    kStoreOuter,        // pop -> слот внешнего кадра
+    kDefineGlobal,      // pop -> определить глобальную переменную globals[arg]
+    kSetGlobal,         // pop -> присвоить существующей глобальной переменной globals[arg]
+    kPop,               // снять вершину стека
+    kJump,              // ip = arg
+    kJumpIfFalse,       // pop, переход если #f
+    kJumpIfFalseOrPop,  // переход без снятия, если на вершине #f (для and)
+    kJumpIfTrueOrPop,   // переход без снятия, если на вершине не #f (для or)
+    kMakeClosure,       // push замыкание для lambdas[arg]
+    kCall,              // вызов с arg аргументами, функция лежит под ними
+    kTailCall,          // kCall в хвостовой позиции: кадр лямбды заменяется вызываемым
+    kReturn,
+    kProfileBegin,      // начать (profile expr)
+    kProfileEnd,        // закончить (profile expr) и напечатать отчёт
+};
+
+struct Instruction {
+    OpCode op;
+    uint32_t arg;
+};
+
+struct BytecodeProto {
+    std::vector<Instruction> code;
+    std::vector<Value> constants;
+    std::vector<std::shared_ptr<LambdaCode>> lambdas;
+    // Кэши глобальных переменных в нодах, из которых построен байткод:
+    // дерево и VM разделяют один кэш на место обращения
+    std::vector<GlobalSlot*> globals;
+    // Наибольшая глубина стека выражений, без учёта слотов кадра
+    uint32_t max_stack = 0;
+};
+////
+
+//// Перевод скомпилированного дерева в байткод
+class BytecodeEmitter {
+public:
+    static std::shared_ptr<BytecodeProto> CompileTopLevel(CompiledNode* node);
+    // Байткод тела строится один раз и кэшируется в LambdaCode
+    static const BytecodeProto* CompileLambda(LambdaCode* code);
+
+    void Emit(OpCode op, uint32_t arg = 0);
+    void EmitConstant(Value value);
+    void EmitLambda(std::shared_ptr<LambdaCode> code);
+    void EmitGlobal(OpCode op, GlobalSlot* slot);
+    void EmitSlot(OpCode local_op, OpCode outer_op, uint32_t depth, uint32_t slot);
+    // Возвращает позицию перехода, цель выставляется через PatchJump
+    size_t EmitJump(OpCode op);
+    void PatchJump(size_t position);
+    // Для веток, которые сливаются: значение одной из них уже учтено
+    void AdjustStack(int delta);
+
+private:
+    BytecodeProto* proto_ = nullptr;
+    int stack_depth_ = 0;
+};
+////
+
+//// Стековая виртуальная машина
+class VirtualMachine {
+public:
+    VirtualMachine();
+    ~VirtualMachine();
+
+    Value Run(const BytecodeProto* proto, Scope* globals);
+    // Стек и кадры в куче - корни сборки мусора
+    void Trace(Heap* heap);
+
+private:
+    struct CallFrame {
+        const BytecodeProto* proto;
+        const Instruction* ip;
+        Value* locals;
+        // Кадр в куче, если его захватывают вложенные лямбды
+        Frame* frame;
+        Frame* parent;
+        // Позиция вызываемой функции: при возврате стек срезается до неё
+        Value* base;
+    };
+
+    Value Execute(size_t entry_depth, Scope* globals);
+    // Кладёт кадр вызова лямбды, лежащей в callee_slot, с argc аргументами над ней
+    void EnterLambda(LambdaFunc* lambda, Value* callee_slot, uint32_t argc);
+    // Вызов встроенной функции: результат заменяет функцию и аргументы на стеке
+    void CallBuiltin(Object* callee, Value* callee_slot);
+    void Unwind(Value* sp);
+    void CheckStack(Value* top);
+
+    // Стек не переаллоцируется: слоты нерасширяемых кадров лежат прямо в нём.
+    // Всё выше sp_ пусто
+    std::unique_ptr<Value[]> stack_;
+    Value* sp_;
+    Value* stack_end_;
+    std::vector<CallFrame> frames_;
+    // Открытые (profile expr), от внешнего к внутреннему
+    std::vector<std::unique_ptr<ProfileSession>> profiles_;
+};
+////